@@ -0,0 +1,254 @@
+/*
+*   Microbenchmarks for the stages of libsmallsh. Each stage is run
+*   over a set of command lines many times and the mean time per line
+*   is printed in nanoseconds.
+*
+*   Usage: bench/microbench [file]
+*   The synthetic lines are always run. The recorded lines are read
+*   from file, or by default from the commands p3testscript sends to
+*   smallsh. Lines with $( ... ) are left out of the expand stage as
+*   they would measure fork and exec.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "smallsh.h"
+
+#define MIN_BENCH_NS 200000000LL   // run each stage at least 0.2 s
+
+const char* syntheticLines[] = {
+    "echo hello world",
+    "ls -l /tmp > out.txt",
+    "wc < junk > junk2",
+    "sleep 100 &",
+    "mkdir testdir$$",
+    "cat <<< $HOME",
+    "x=$HOME/file",
+    "echo $x ${HOME} and $PATH",
+    "echo ${HOME##*/} ${HOME%/*} ${#HOME} ${HOME:1:3} ${HOME//o/0}",
+    "for i in a b c; do echo $i; done",
+    "while test -f lockfile; do sleep 1; done",
+    "f() { echo $1 $2; echo $#; }",
+    "# a comment line",
+};
+
+/* struct for a set of lines to run the stages on */
+struct lineSet
+{
+    char** lines;
+    int numLines;
+};
+
+/*
+*   Returns nanoseconds from a monotonic clock.
+*/
+long long nowNs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+*   Add a copy of line, without its newline, to set.
+*/
+void addLine(struct lineSet* set, const char* line)
+{
+    set->lines = realloc(set->lines, (set->numLines + 1) * sizeof(char*));
+    set->lines[set->numLines] = strdup(line);
+    set->lines[set->numLines][strcspn(set->lines[set->numLines], "\n")] = 0;
+    set->numLines++;
+}
+
+/*
+*   Read recorded lines from fileName. For p3testscript only the lines
+*   between the ___EOF___ markers are used.
+*/
+void readRecordedLines(struct lineSet* set, const char* fileName)
+{
+    char line[MAX_COMMAND_LINE_LENGTH];
+    FILE* file = fopen(fileName, "r");
+    bool inScript = false;
+    bool hasMarkers = false;
+
+    if(file == NULL)
+    {
+        perror(fileName);
+        return;
+    }
+
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        if(strstr(line, "___EOF___") != NULL)
+        {
+            hasMarkers = true;
+            inScript = !inScript && strstr(line, "<<") != NULL;
+            continue;
+        }
+        if(inScript || !hasMarkers)
+        {
+            addLine(set, line);
+        }
+    }
+
+    fclose(file);
+}
+
+/*
+*   Lexing stage: $$ replacement and splitting into words.
+*/
+void lexLines(struct shellContext* shell, struct lineSet* set)
+{
+    char buffer[MAX_COMMAND_LINE_LENGTH];
+    char* line;
+    char* cursor;
+    int i;
+
+    for(i = 0; i < set->numLines; i++)
+    {
+        strcpy(buffer, set->lines[i]);
+        line = replaceString(buffer);
+        cursor = line;
+        while(nextWord(&cursor) != NULL)
+        {
+        }
+        if(line != buffer)
+        {
+            free(line);
+        }
+    }
+}
+
+/*
+*   Parsing stage: parse each line into nodes and free them.
+*/
+void parseLines(struct shellContext* shell, struct lineSet* set)
+{
+    char buffer[MAX_COMMAND_LINE_LENGTH];
+    int i;
+
+    for(i = 0; i < set->numLines; i++)
+    {
+        strcpy(buffer, set->lines[i]);
+        freeNodeList(parseLine(shell, buffer, false));
+    }
+}
+
+/* parsed lines used by the expand stage */
+struct commandNode** parsedNodes;
+
+/*
+*   Expansion stage: expand the words and redirection files of each
+*   parsed command for a run and release them.
+*/
+void expandLines(struct shellContext* shell, struct lineSet* set)
+{
+    int i;
+
+    for(i = 0; i < set->numLines; i++)
+    {
+        if(parsedNodes[i] != NULL && parsedNodes[i]->type == NODE_COMMAND)
+        {
+            expandCommand(shell, parsedNodes[i]->command);
+            releaseExpansion(parsedNodes[i]->command);
+        }
+    }
+}
+
+/*
+*   Job table stage: add as many jobs as lines and remove them again.
+*/
+void jobLines(struct shellContext* shell, struct lineSet* set)
+{
+    int i;
+
+    for(i = 0; i < set->numLines; i++)
+    {
+        addToPIDList(shell, 100000 + i);
+    }
+    for(i = set->numLines - 1; i >= 0; i--)
+    {
+        removeFromPIDList(shell, 100000 + i);
+    }
+}
+
+/*
+*   Run stage over set until MIN_BENCH_NS have passed and print the
+*   mean nanoseconds per line.
+*/
+void runStage(const char* name, struct shellContext* shell, struct lineSet* set,
+    void (*stage)(struct shellContext*, struct lineSet*))
+{
+    long long start = nowNs();
+    long long elapsed;
+    long long rounds = 0;
+
+    do
+    {
+        stage(shell, set);
+        rounds++;
+        elapsed = nowNs() - start;
+    }
+    while(elapsed < MIN_BENCH_NS);
+
+    printf("  %-8s %10.1f ns/line\n", name, (double)elapsed / (rounds * set->numLines));
+    fflush(stdout);
+}
+
+/*
+*   Run all stages over set.
+*/
+void runStages(const char* title, struct shellContext* shell, struct lineSet* set)
+{
+    char buffer[MAX_COMMAND_LINE_LENGTH];
+    int i;
+
+    printf("%s (%d lines)\n", title, set->numLines);
+
+    parsedNodes = calloc(set->numLines, sizeof(struct commandNode*));
+    for(i = 0; i < set->numLines; i++)
+    {
+        if(strstr(set->lines[i], "$(") == NULL)
+        {
+            strcpy(buffer, set->lines[i]);
+            parsedNodes[i] = parseLine(shell, buffer, false);
+        }
+    }
+
+    runStage("lex", shell, set, lexLines);
+    runStage("parse", shell, set, parseLines);
+    runStage("expand", shell, set, expandLines);
+    runStage("jobs", shell, set, jobLines);
+
+    for(i = 0; i < set->numLines; i++)
+    {
+        freeNodeList(parsedNodes[i]);
+    }
+    free(parsedNodes);
+}
+
+int main(int argc, char* argv[])
+{
+    struct shellContext* shell = createShell();
+    struct lineSet synthetic = {0};
+    struct lineSet recorded = {0};
+    int i;
+
+    for(i = 0; i < (int)(sizeof(syntheticLines) / sizeof(syntheticLines[0])); i++)
+    {
+        addLine(&synthetic, syntheticLines[i]);
+    }
+    readRecordedLines(&recorded, argc > 1 ? argv[1] : "p3testscript");
+
+    runStages("synthetic", shell, &synthetic);
+    if(recorded.numLines > 0)
+    {
+        runStages("recorded", shell, &recorded);
+    }
+
+    return EXIT_SUCCESS;
+}
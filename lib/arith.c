@@ -0,0 +1,631 @@
+/*
+*   Arithmetic expansion $(( ... )) and the built in let, evaluated in
+*   the shell with 64-bit integers and the C operators and precedence.
+*   An expression is parsed into a tree once and kept by its text in
+*   the shell's cache, so a loop that counts evaluates the same tree
+*   on each iteration without parsing it again or starting a process.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "smallsh.h"
+
+#define ARITH_CACHE_SIZE 1024   // parsed expressions kept, by text
+#define ARITH_ERROR_SIZE 128
+
+/* operators of arithmetic expression nodes */
+enum arithOp
+{
+    ARITH_NUMBER,
+    ARITH_VARIABLE,
+    ARITH_NEGATE, ARITH_NOT, ARITH_COMPLEMENT,
+    ARITH_PRE_INCREMENT, ARITH_PRE_DECREMENT,
+    ARITH_POST_INCREMENT, ARITH_POST_DECREMENT,
+    ARITH_MULTIPLY, ARITH_DIVIDE, ARITH_REMAINDER,
+    ARITH_ADD, ARITH_SUBTRACT,
+    ARITH_SHIFT_LEFT, ARITH_SHIFT_RIGHT,
+    ARITH_LESS, ARITH_LESS_EQUAL, ARITH_GREATER, ARITH_GREATER_EQUAL,
+    ARITH_EQUAL, ARITH_NOT_EQUAL,
+    ARITH_BIT_AND, ARITH_BIT_XOR, ARITH_BIT_OR,
+    ARITH_AND, ARITH_OR,
+    ARITH_CONDITIONAL,
+    ARITH_ASSIGN,
+    ARITH_COMMA
+};
+
+/* struct for a node of a parsed arithmetic expression */
+struct arithNode
+{
+    enum arithOp op;
+    enum arithOp assignOp;  // ARITH_ASSIGN, or the op of += and the like
+    long long value;        // ARITH_NUMBER
+    char* name;             // ARITH_VARIABLE
+    struct arithNode* operands[3];
+};
+
+/* struct for a binary operator, its text and precedence */
+struct arithOperator
+{
+    const char* text;
+    int precedence;     // higher binds tighter
+    enum arithOp op;
+};
+
+// Longer operators come before their prefixes
+const struct arithOperator binaryOperators[] = {
+    {"||", 1, ARITH_OR}, {"&&", 2, ARITH_AND},
+    {"==", 6, ARITH_EQUAL}, {"!=", 6, ARITH_NOT_EQUAL},
+    {"<=", 7, ARITH_LESS_EQUAL}, {">=", 7, ARITH_GREATER_EQUAL},
+    {"<<", 8, ARITH_SHIFT_LEFT}, {">>", 8, ARITH_SHIFT_RIGHT},
+    {"|", 3, ARITH_BIT_OR}, {"^", 4, ARITH_BIT_XOR}, {"&", 5, ARITH_BIT_AND},
+    {"<", 7, ARITH_LESS}, {">", 7, ARITH_GREATER},
+    {"+", 9, ARITH_ADD}, {"-", 9, ARITH_SUBTRACT},
+    {"*", 10, ARITH_MULTIPLY}, {"/", 10, ARITH_DIVIDE}, {"%", 10, ARITH_REMAINDER},
+    {NULL, 0, ARITH_NUMBER}};
+
+const struct arithOperator assignOperators[] = {
+    {"<<=", 0, ARITH_SHIFT_LEFT}, {">>=", 0, ARITH_SHIFT_RIGHT},
+    {"+=", 0, ARITH_ADD}, {"-=", 0, ARITH_SUBTRACT}, {"*=", 0, ARITH_MULTIPLY},
+    {"/=", 0, ARITH_DIVIDE}, {"%=", 0, ARITH_REMAINDER}, {"&=", 0, ARITH_BIT_AND},
+    {"^=", 0, ARITH_BIT_XOR}, {"|=", 0, ARITH_BIT_OR}, {"=", 0, ARITH_ASSIGN},
+    {NULL, 0, ARITH_NUMBER}};
+
+/* struct for the state of parsing an expression */
+struct arithParser
+{
+    const char* cursor;
+    char error[ARITH_ERROR_SIZE];   // empty while there is none
+};
+
+struct arithNode* parseComma(struct arithParser* parser);
+struct arithNode* parseAssign(struct arithParser* parser);
+
+/*
+*   Free the tree of node.
+*/
+void freeArithNode(struct arithNode* node)
+{
+    int i;
+
+    if(node == NULL)
+    {
+        return;
+    }
+    for(i = 0; i < 3; i++)
+    {
+        freeArithNode(node->operands[i]);
+    }
+    free(node->name);
+    free(node);
+}
+
+/*
+*   Returns a new node for op with up to three operands.
+*/
+struct arithNode* newArithNode(enum arithOp op, struct arithNode* first, struct arithNode* second,
+    struct arithNode* third)
+{
+    struct arithNode* node = calloc(1, sizeof(struct arithNode));
+
+    node->op = op;
+    node->operands[0] = first;
+    node->operands[1] = second;
+    node->operands[2] = third;
+
+    return node;
+}
+
+/*
+*   Skip spaces, tabs and new lines at the cursor of parser.
+*/
+void skipArithSpace(struct arithParser* parser)
+{
+    parser->cursor += strspn(parser->cursor, " \t\n");
+}
+
+/*
+*   Set the error of parser if there is none yet.
+*/
+void setArithError(struct arithParser* parser, const char* message)
+{
+    if(parser->error[0] == 0)
+    {
+        snprintf(parser->error, sizeof(parser->error), "%s", message);
+    }
+}
+
+/*
+*   Returns true and moves past text if it is next.
+*/
+bool acceptArith(struct arithParser* parser, const char* text)
+{
+    skipArithSpace(parser);
+    if(strncmp(parser->cursor, text, strlen(text)) == 0)
+    {
+        parser->cursor += strlen(text);
+        return true;
+    }
+
+    return false;
+}
+
+/*
+*   Returns the operator of table that is next, or NULL.
+*/
+const struct arithOperator* peekArithOperator(struct arithParser* parser, const struct arithOperator* table)
+{
+    int i;
+
+    skipArithSpace(parser);
+    for(i = 0; table[i].text != NULL; i++)
+    {
+        if(strncmp(parser->cursor, table[i].text, strlen(table[i].text)) == 0)
+        {
+            // = is not the start of ==
+            if(table == assignOperators && table[i].op == ARITH_ASSIGN && parser->cursor[1] == '=')
+            {
+                return NULL;
+            }
+            return &table[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+*   Parse a number, a variable name or a parenthesized expression,
+*   then any ++ or -- after it.
+*/
+struct arithNode* parsePrimary(struct arithParser* parser)
+{
+    struct arithNode* node;
+    char* end;
+    int nameLen;
+
+    skipArithSpace(parser);
+    if(acceptArith(parser, "("))
+    {
+        node = parseComma(parser);
+        if(!acceptArith(parser, ")"))
+        {
+            setArithError(parser, "missing )");
+        }
+        return node;
+    }
+    if(*parser->cursor >= '0' && *parser->cursor <= '9')
+    {
+        node = newArithNode(ARITH_NUMBER, NULL, NULL, NULL);
+        node->value = (long long)strtoull(parser->cursor, &end, 0);
+        parser->cursor = end;
+        if(variableNameLength(end) > 0 || (*end >= '0' && *end <= '9'))
+        {
+            setArithError(parser, "bad number");
+        }
+        return node;
+    }
+    if((nameLen = variableNameLength(parser->cursor)) > 0)
+    {
+        node = newArithNode(ARITH_VARIABLE, NULL, NULL, NULL);
+        node->name = strndup(parser->cursor, nameLen);
+        parser->cursor += nameLen;
+        if(acceptArith(parser, "++"))
+        {
+            node = newArithNode(ARITH_POST_INCREMENT, node, NULL, NULL);
+        }
+        else if(acceptArith(parser, "--"))
+        {
+            node = newArithNode(ARITH_POST_DECREMENT, node, NULL, NULL);
+        }
+        return node;
+    }
+
+    setArithError(parser, *parser->cursor == 0 ? "operand expected" : "syntax error");
+    return newArithNode(ARITH_NUMBER, NULL, NULL, NULL);
+}
+
+/*
+*   Parse the unary operators + - ! ~ ++ and -- before an operand.
+*/
+struct arithNode* parseUnary(struct arithParser* parser)
+{
+    struct arithNode* operand;
+    enum arithOp op;
+
+    if(acceptArith(parser, "++") || acceptArith(parser, "--"))
+    {
+        op = parser->cursor[-1] == '+' ? ARITH_PRE_INCREMENT : ARITH_PRE_DECREMENT;
+        operand = parseUnary(parser);
+        if(operand->op != ARITH_VARIABLE)
+        {
+            setArithError(parser, "++ or -- needs a variable");
+        }
+        return newArithNode(op, operand, NULL, NULL);
+    }
+    if(acceptArith(parser, "+"))
+    {
+        return parseUnary(parser);
+    }
+    if(acceptArith(parser, "-"))
+    {
+        return newArithNode(ARITH_NEGATE, parseUnary(parser), NULL, NULL);
+    }
+    if(acceptArith(parser, "!"))
+    {
+        return newArithNode(ARITH_NOT, parseUnary(parser), NULL, NULL);
+    }
+    if(acceptArith(parser, "~"))
+    {
+        return newArithNode(ARITH_COMPLEMENT, parseUnary(parser), NULL, NULL);
+    }
+
+    return parsePrimary(parser);
+}
+
+/*
+*   Parse binary operators of precedence minPrecedence and higher,
+*   left to right, by precedence climbing.
+*/
+struct arithNode* parseBinary(struct arithParser* parser, int minPrecedence)
+{
+    const struct arithOperator* operator;
+    struct arithNode* left = parseUnary(parser);
+
+    while((operator = peekArithOperator(parser, binaryOperators)) != NULL &&
+        operator->precedence >= minPrecedence && peekArithOperator(parser, assignOperators) == NULL)
+    {
+        parser->cursor += strlen(operator->text);
+        left = newArithNode(operator->op, left, parseBinary(parser, operator->precedence + 1), NULL);
+    }
+
+    return left;
+}
+
+/*
+*   Parse an assignment to a variable, right to left, or a
+*   conditional expression.
+*/
+struct arithNode* parseAssign(struct arithParser* parser)
+{
+    const struct arithOperator* operator;
+    struct arithNode* node = parseBinary(parser, 1);
+    struct arithNode* then;
+
+    if(acceptArith(parser, "?"))
+    {
+        then = parseComma(parser);
+        if(!acceptArith(parser, ":"))
+        {
+            setArithError(parser, "missing :");
+        }
+        return newArithNode(ARITH_CONDITIONAL, node, then, parseAssign(parser));
+    }
+
+    operator = peekArithOperator(parser, assignOperators);
+    if(operator == NULL)
+    {
+        return node;
+    }
+    if(node->op != ARITH_VARIABLE)
+    {
+        setArithError(parser, "assignment needs a variable");
+    }
+    parser->cursor += strlen(operator->text);
+    node = newArithNode(ARITH_ASSIGN, node, parseAssign(parser), NULL);
+    node->assignOp = operator->op;
+
+    return node;
+}
+
+/*
+*   Parse expressions separated by commas.
+*/
+struct arithNode* parseComma(struct arithParser* parser)
+{
+    struct arithNode* node = parseAssign(parser);
+
+    while(acceptArith(parser, ","))
+    {
+        node = newArithNode(ARITH_COMMA, node, parseAssign(parser), NULL);
+    }
+
+    return node;
+}
+
+/*
+*   Returns the tree of the expression text, from the cache of shell
+*   or parsed and added to it, or NULL with the error in error. Once
+*   the cache is full a new tree is not kept, and isCached is false
+*   for the caller to free it.
+*/
+struct arithNode* compileArithmetic(struct shellContext* shell, const char* text, char* error, bool* isCached)
+{
+    struct arithParser parser = {text, ""};
+    struct arithNode* tree = hashLookup(&shell->arithCache, text);
+
+    *isCached = true;
+    if(tree != NULL)
+    {
+        return tree;
+    }
+
+    tree = parseComma(&parser);
+    skipArithSpace(&parser);
+    if(parser.error[0] == 0 && *parser.cursor != 0)
+    {
+        setArithError(&parser, "syntax error");
+    }
+    if(parser.error[0] != 0)
+    {
+        strcpy(error, parser.error);
+        freeArithNode(tree);
+        return NULL;
+    }
+
+    *isCached = shell->arithCache.numEntries < ARITH_CACHE_SIZE;
+    if(*isCached)
+    {
+        hashInsert(&shell->arithCache, text, tree);
+    }
+
+    return tree;
+}
+
+/*
+*   Evaluate op on left and right, wrapping on overflow as unsigned
+*   math does. Returns false with error set on division by zero.
+*/
+bool applyArithOp(enum arithOp op, long long left, long long right, long long* result, char* error)
+{
+    unsigned long long a = left;
+    unsigned long long b = right;
+
+    switch(op)
+    {
+        case ARITH_MULTIPLY:        *result = (long long)(a * b); break;
+        case ARITH_ADD:             *result = (long long)(a + b); break;
+        case ARITH_SUBTRACT:        *result = (long long)(a - b); break;
+        case ARITH_SHIFT_LEFT:      *result = (long long)(a << (right & 63)); break;
+        case ARITH_SHIFT_RIGHT:     *result = left >> (right & 63); break;
+        case ARITH_LESS:            *result = left < right; break;
+        case ARITH_LESS_EQUAL:      *result = left <= right; break;
+        case ARITH_GREATER:         *result = left > right; break;
+        case ARITH_GREATER_EQUAL:   *result = left >= right; break;
+        case ARITH_EQUAL:           *result = left == right; break;
+        case ARITH_NOT_EQUAL:       *result = left != right; break;
+        case ARITH_BIT_AND:         *result = left & right; break;
+        case ARITH_BIT_XOR:         *result = left ^ right; break;
+        case ARITH_BIT_OR:          *result = left | right; break;
+        case ARITH_ASSIGN:          *result = right; break;
+        case ARITH_DIVIDE:
+        case ARITH_REMAINDER:
+            if(right == 0)
+            {
+                strcpy(error, "division by zero");
+                return false;
+            }
+            // The one quotient that overflows wraps
+            if(right == -1)
+            {
+                *result = op == ARITH_DIVIDE ? (long long)(0 - a) : 0;
+            }
+            else
+            {
+                *result = op == ARITH_DIVIDE ? left / right : left % right;
+            }
+            break;
+        default:
+            break;
+    }
+
+    return true;
+}
+
+/*
+*   Get the value of variable name as a number, 0 if it is unset or
+*   empty. Returns false with error set if it is not a number.
+*/
+bool getArithVariable(struct shellContext* shell, const char* name, long long* value, char* error)
+{
+    const char* text = getVariable(shell, name);
+    char* end;
+
+    text = text != NULL ? text + strspn(text, " \t\n") : "";
+    if(*text == 0)
+    {
+        *value = 0;
+        return true;
+    }
+
+    *value = strtoll(text, &end, 0);
+    if(end[strspn(end, " \t\n")] != 0)
+    {
+        snprintf(error, ARITH_ERROR_SIZE, "%s: not a number", name);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+*   Set variable name of shell to value.
+*/
+void setArithVariable(struct shellContext* shell, const char* name, long long value)
+{
+    char text[32];
+
+    sprintf(text, "%lld", value);
+    setVariable(shell, name, text);
+}
+
+/*
+*   Evaluate the tree of node. Returns false with error set if it
+*   divides by zero or uses a variable that is not a number.
+*/
+bool evaluateArithNode(struct shellContext* shell, struct arithNode* node, long long* result, char* error)
+{
+    struct arithNode* variable = node->operands[0];
+    long long left = 0;
+    long long right = 0;
+
+    switch(node->op)
+    {
+        case ARITH_NUMBER:
+            *result = node->value;
+            return true;
+        case ARITH_VARIABLE:
+            return getArithVariable(shell, node->name, result, error);
+        case ARITH_AND:
+        case ARITH_OR:
+            // The right operand is only evaluated if it decides
+            if(!evaluateArithNode(shell, node->operands[0], &left, error))
+            {
+                return false;
+            }
+            if((node->op == ARITH_AND) == (left != 0))
+            {
+                if(!evaluateArithNode(shell, node->operands[1], &right, error))
+                {
+                    return false;
+                }
+                left = right;
+            }
+            *result = left != 0;
+            return true;
+        case ARITH_CONDITIONAL:
+            if(!evaluateArithNode(shell, node->operands[0], &left, error))
+            {
+                return false;
+            }
+            return evaluateArithNode(shell, node->operands[left != 0 ? 1 : 2], result, error);
+        case ARITH_COMMA:
+            return evaluateArithNode(shell, node->operands[0], &left, error) &&
+                evaluateArithNode(shell, node->operands[1], result, error);
+        case ARITH_PRE_INCREMENT:
+        case ARITH_PRE_DECREMENT:
+        case ARITH_POST_INCREMENT:
+        case ARITH_POST_DECREMENT:
+            if(!getArithVariable(shell, variable->name, &left, error))
+            {
+                return false;
+            }
+            right = (long long)((unsigned long long)left +
+                (node->op == ARITH_PRE_INCREMENT || node->op == ARITH_POST_INCREMENT ? 1 : -1));
+            setArithVariable(shell, variable->name, right);
+            *result = node->op == ARITH_PRE_INCREMENT || node->op == ARITH_PRE_DECREMENT ? right : left;
+            return true;
+        case ARITH_ASSIGN:
+            if(!evaluateArithNode(shell, node->operands[1], &right, error) ||
+                (node->assignOp != ARITH_ASSIGN && !getArithVariable(shell, variable->name, &left, error)) ||
+                !applyArithOp(node->assignOp, left, right, result, error))
+            {
+                return false;
+            }
+            setArithVariable(shell, variable->name, *result);
+            return true;
+        default:
+            break;
+    }
+
+    if(!evaluateArithNode(shell, node->operands[0], &left, error))
+    {
+        return false;
+    }
+    switch(node->op)
+    {
+        case ARITH_NEGATE:
+            *result = (long long)(0 - (unsigned long long)left);
+            return true;
+        case ARITH_NOT:
+            *result = !left;
+            return true;
+        case ARITH_COMPLEMENT:
+            *result = ~left;
+            return true;
+        default:
+            break;
+    }
+
+    return evaluateArithNode(shell, node->operands[1], &right, error) &&
+        applyArithOp(node->op, left, right, result, error);
+}
+
+/*
+*   Evaluate the arithmetic expression text into result. An error is
+*   printed and false returned if it does not parse, divides by zero
+*   or uses a variable that is not a number.
+*/
+bool evaluateArithmetic(struct shellContext* shell, const char* text, long long* result)
+{
+    char error[ARITH_ERROR_SIZE] = "";
+    bool isCached = true;
+    struct arithNode* tree = compileArithmetic(shell, text, error, &isCached);
+    bool isEvaluated = tree != NULL && evaluateArithNode(shell, tree, result, error);
+
+    if(!isCached)
+    {
+        freeArithNode(tree);
+    }
+    if(!isEvaluated)
+    {
+        fprintf(stderr, "smallsh: %s: %s\n", text, error);
+        fflush(stderr);
+    }
+
+    return isEvaluated;
+}
+
+/*
+*   Runs the built in command let, which evaluates each argument as
+*   an arithmetic expression. Its status is 0 if the last one is not
+*   0, and 1 if it is 0 or an expression fails. An expression in
+*   quotes may have spaces, the words up to the closing quote are
+*   joined.
+*/
+void runLetCommand(struct shellContext* shell, struct commandElements* curCommand)
+{
+    long long value = 0;
+    char* expression;
+    char quote;
+    int len = 0;
+    int i;
+
+    if(curCommand->numArguments < 2)
+    {
+        fprintf(stderr, "usage: let EXPRESSION...\n");
+        strcpy(shell->exitStatus, "exit value 2");
+        return;
+    }
+
+    for(i = 1; i < curCommand->numArguments; i++)
+    {
+        expression = curCommand->commands[i];
+        quote = expression[0];
+        if(quote == '\'' || quote == '"')
+        {
+            expression = NULL;
+            len = 0;
+            appendToField(&expression, &len, curCommand->commands[i] + 1, strlen(curCommand->commands[i] + 1));
+            while((len == 0 || expression[len - 1] != quote) && i + 1 < curCommand->numArguments)
+            {
+                i++;
+                appendToField(&expression, &len, " ", 1);
+                appendToField(&expression, &len, curCommand->commands[i], strlen(curCommand->commands[i]));
+            }
+            if(len > 0 && expression[len - 1] == quote)
+            {
+                expression[len - 1] = 0;
+            }
+            addOwnedBuffer(&curCommand->expansion, expression);
+        }
+        if(!evaluateArithmetic(shell, expression, &value))
+        {
+            strcpy(shell->exitStatus, "exit value 1");
+            return;
+        }
+    }
+
+    strcpy(shell->exitStatus, value != 0 ? "exit value 0" : "exit value 1");
+}
@@ -0,0 +1,294 @@
+/*
+*   Status board: with SMALLSH_BOARD set, the shell maps a file with
+*   the layout of board.h and updates it when it starts or reaps a
+*   job, see smallsh-board.c for a reader. If SMALLSH_BOARD names a
+*   directory the file is smallsh.PID in it, removed when the shell
+*   exits, and each --serve session has a board of its own there.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "smallsh.h"
+
+#define BOARD_POST_WAIT 100000000LL  // ns a child waits to be posted
+
+// Board file the shell removes when it exits, if it made the name
+char boardPath[4096];
+pid_t boardOwner = -1;
+
+/*
+*   Returns CLOCK_REALTIME in ns.
+*/
+long long realtimeNs()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/*
+*   Remove the board file made by this shell, when it closes its board
+*   or at exit.
+*/
+void removeBoardFile()
+{
+    if(boardOwner == getpid() && boardPath[0] != 0)
+    {
+        unlink(boardPath);
+        boardPath[0] = 0;
+    }
+}
+
+/*
+*   Map the board of shell at path, a file or a directory to make the
+*   file in. Nothing is done if path is NULL or empty, and a failure
+*   is reported and leaves the shell without a board.
+*/
+void openStatusBoard(struct shellContext* shell, const char* path)
+{
+    struct statusBoard* board;
+    struct stat info;
+    int fd;
+
+    if(path == NULL || path[0] == 0)
+    {
+        return;
+    }
+
+    snprintf(boardPath, sizeof(boardPath), "%s", path);
+    if(stat(path, &info) == 0 && S_ISDIR(info.st_mode))
+    {
+        snprintf(boardPath, sizeof(boardPath), "%s/smallsh.%d", path, getpid());
+        if(boardOwner == -1)
+        {
+            atexit(removeBoardFile);
+        }
+        boardOwner = getpid();
+    }
+
+    fd = open(boardPath, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(fd == -1 || ftruncate(fd, sizeof(struct statusBoard)) == -1)
+    {
+        perror(boardPath);
+        fflush(stderr);
+        if(fd != -1)
+        {
+            close(fd);
+        }
+        return;
+    }
+    board = mmap(NULL, sizeof(struct statusBoard), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(board == MAP_FAILED)
+    {
+        perror(boardPath);
+        fflush(stderr);
+        return;
+    }
+
+    // A reader sees an update in progress until the board is filled
+    __atomic_store_n(&board->sequence, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memset(&board->shellPID, 0, sizeof(struct statusBoard) - offsetof(struct statusBoard, shellPID));
+    board->magic = BOARD_MAGIC;
+    board->version = BOARD_VERSION;
+    board->size = sizeof(struct statusBoard);
+    board->shellPID = getpid();
+    board->foregroundOnly = shell->foregroundOnly;
+    __atomic_store_n(&board->sequence, 2, __ATOMIC_RELEASE);
+    shell->board = board;
+}
+
+/*
+*   Unmap the board of shell, and remove its file if this shell made
+*   it. A shell forked to run commands forgets the board of its
+*   parent this way, so only the shell that made it writes it.
+*/
+void closeStatusBoard(struct shellContext* shell)
+{
+    if(shell->board != NULL)
+    {
+        munmap(shell->board, sizeof(struct statusBoard));
+        shell->board = NULL;
+    }
+    removeBoardFile();
+}
+
+/*
+*   Give a --serve session, a fork of the server, a board of its own
+*   at path, in place of the server's. Only a directory can hold one
+*   per session, so with a board file the session has none.
+*/
+void openSessionBoard(struct shellContext* shell, const char* path)
+{
+    struct stat info;
+
+    closeStatusBoard(shell);
+    if(path != NULL && stat(path, &info) == 0 && S_ISDIR(info.st_mode))
+    {
+        openStatusBoard(shell, path);
+    }
+}
+
+/*
+*   Start an update of board, readers retry until it ends.
+*/
+void beginBoardUpdate(struct statusBoard* board)
+{
+    __atomic_store_n(&board->sequence, board->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/*
+*   End an update of board.
+*/
+void endBoardUpdate(struct statusBoard* board)
+{
+    __atomic_store_n(&board->sequence, board->sequence + 1, __ATOMIC_RELEASE);
+}
+
+/*
+*   Fill job with pid, running from now, and the numWords words.
+*/
+void fillBoardJob(struct boardJob* job, pid_t pid, char* const* words, int numWords)
+{
+    int len = 0;
+    int i;
+
+    memset(job, 0, sizeof(struct boardJob));
+    job->pid = pid;
+    job->state = BOARD_JOB_RUNNING;
+    job->startTime = realtimeNs();
+    job->waitStatus = -1;
+    for(i = 0; i < numWords && len < BOARD_ARGV_SIZE - 1; i++)
+    {
+        len += snprintf(job->argv + len, BOARD_ARGV_SIZE - len, i ? " %s" : "%s", words[i]);
+    }
+}
+
+/*
+*   Post background job pid, started with the numWords words, to the
+*   board of shell. It takes the next free slot, or that of the job
+*   that has been done longest. If every slot holds a running job it
+*   is left off.
+*/
+void postBoardJob(struct shellContext* shell, pid_t pid, char* const* words, int numWords)
+{
+    struct statusBoard* board = shell->board;
+    int slot = -1;
+    int i;
+
+    if(board == NULL)
+    {
+        return;
+    }
+
+    // Slots are used in order and only reused once all are
+    if(board->numJobs < BOARD_MAX_JOBS)
+    {
+        slot = board->numJobs;
+    }
+    for(i = 0; i < BOARD_MAX_JOBS && board->numJobs == BOARD_MAX_JOBS; i++)
+    {
+        if(board->jobs[i].state == BOARD_JOB_DONE && (slot == -1 ||
+            board->jobs[i].endTime < board->jobs[slot].endTime))
+        {
+            slot = i;
+        }
+    }
+    if(slot == -1)
+    {
+        return;
+    }
+
+    beginBoardUpdate(board);
+    fillBoardJob(&board->jobs[slot], pid, words, numWords);
+    if(slot >= board->numJobs)
+    {
+        board->numJobs = slot + 1;
+    }
+    endBoardUpdate(board);
+}
+
+/*
+*   Mark background job pid done on the board of shell, with its wait
+*   status, or -1 if it is not known.
+*/
+void finishBoardJob(struct shellContext* shell, pid_t pid, int waitStatus)
+{
+    struct statusBoard* board = shell->board;
+    int i;
+
+    if(board == NULL)
+    {
+        return;
+    }
+
+    for(i = 0; i < board->numJobs; i++)
+    {
+        if(board->jobs[i].pid == pid && board->jobs[i].state == BOARD_JOB_RUNNING)
+        {
+            beginBoardUpdate(board);
+            board->jobs[i].state = BOARD_JOB_DONE;
+            board->jobs[i].endTime = realtimeNs();
+            board->jobs[i].waitStatus = waitStatus;
+            endBoardUpdate(board);
+            break;
+        }
+    }
+}
+
+/*
+*   Post the foreground job pid, run with the numWords words, to the
+*   board of shell, or clear it if pid is -1.
+*/
+void postBoardForeground(struct shellContext* shell, pid_t pid, char* const* words, int numWords)
+{
+    struct statusBoard* board = shell->board;
+
+    if(board == NULL)
+    {
+        return;
+    }
+
+    beginBoardUpdate(board);
+    if(pid == -1)
+    {
+        memset(&board->foreground, 0, sizeof(struct boardJob));
+    }
+    else
+    {
+        fillBoardJob(&board->foreground, pid, words, numWords);
+    }
+    endBoardUpdate(board);
+}
+
+/*
+*   In a foreground child pid that is about to exec, wait until the
+*   parent has posted it as the foreground job, so a command that
+*   reads the board sees itself. Gives up after BOARD_POST_WAIT.
+*/
+void waitForBoardForeground(struct shellContext* shell, pid_t pid)
+{
+    long long deadline = monotonicNs() + BOARD_POST_WAIT;
+
+    if(shell->board == NULL)
+    {
+        return;
+    }
+    while(__atomic_load_n(&shell->board->foreground.pid, __ATOMIC_ACQUIRE) != pid &&
+        monotonicNs() < deadline)
+    {
+        sched_yield();
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef SMALLSH_BOARD_H
+#define SMALLSH_BOARD_H
+
+/*
+*   Layout of the status board, a file a shell maps and keeps up to
+*   date with what it is running, so a monitor reads it instead of
+*   scraping ps. The layout is fixed: fields have fixed sizes and
+*   offsets, and version changes if they do.
+*
+*   The board is written only by the shell, under a seqlock. sequence
+*   is odd while an update is in progress. A reader copies the board
+*   and keeps the copy if sequence was even and the same before and
+*   after, else it copies again, so it never blocks the shell.
+*   foregroundOnly is outside the seqlock, as it is set by the SIGTSTP
+*   handler, and is read on its own.
+*/
+
+#include <stdint.h>
+
+#define BOARD_MAGIC 0x44524f4248534d53ULL  // "SMSHBORD" little-endian
+#define BOARD_VERSION 1
+#define BOARD_MAX_JOBS 64       // background jobs kept on the board
+#define BOARD_ARGV_SIZE 80      // bytes of the words of a job, with null
+
+/* states of a job on the board */
+enum boardJobState
+{
+    BOARD_JOB_FREE,         // slot not used
+    BOARD_JOB_RUNNING,
+    BOARD_JOB_DONE          // reaped, kept until its slot is needed
+};
+
+/* struct for a job on the board */
+struct boardJob
+{
+    int32_t pid;
+    int32_t state;          // enum boardJobState
+    int64_t startTime;      // CLOCK_REALTIME ns
+    int64_t endTime;        // CLOCK_REALTIME ns, when done
+    int32_t waitStatus;     // wait status when done, -1 if unknown
+    char argv[BOARD_ARGV_SIZE];     // words joined with spaces, cut
+                                    // short if too long
+    char reserved[4];
+};
+
+/* struct for the whole board, the size of the file */
+struct statusBoard
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t size;              // sizeof(struct statusBoard)
+    uint64_t sequence;          // seqlock, odd during an update
+    int32_t shellPID;
+    int32_t foregroundOnly;     // outside the seqlock
+    struct boardJob foreground; // state BOARD_JOB_FREE if none
+    int32_t numJobs;            // slots of jobs used, up to
+    int32_t reserved;           // BOARD_MAX_JOBS
+    struct boardJob jobs[BOARD_MAX_JOBS];
+};
+
+#endif
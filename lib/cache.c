@@ -0,0 +1,625 @@
+/*
+*   The cache built in: a deterministic command is run once for each
+*   set of inputs, and later runs restore its stdout, the files it
+*   wrote and its exit status from a store on disk. Results are kept
+*   in a content-addressed store, one blob per distinct content, and
+*   are put back with a reflink where the filesystem has them or with
+*   copyFD otherwise, so a hit copies no data through the shell.
+*
+*   A store directory holds entries/KEY, a manifest for each key, and
+*   blobs/HASH for each content. Keys and blobs are named by the
+*   SHA-256 of their input or content in hex, so a hit never replays
+*   the results of another command.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+
+#include "smallsh.h"
+
+#define CACHE_BUFFER_SIZE (128 * 1024)
+
+/*
+*   Add string text to hash, with its terminating 0 so that words can
+*   not run together.
+*/
+void hashText(struct sha256Context* hash, const char* text)
+{
+    sha256Update(hash, text, strlen(text) + 1);
+}
+
+/*
+*   Add the content of fd, read from the start, to *hash. Returns
+*   false if it could not be read.
+*/
+bool hashContent(int fd, struct sha256Context* hash)
+{
+    char* buffer = malloc(CACHE_BUFFER_SIZE);
+    off_t offset = 0;
+    ssize_t n;
+
+    while((n = pread(fd, buffer, CACHE_BUFFER_SIZE, offset)) != 0)
+    {
+        if(n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n == -1)
+        {
+            free(buffer);
+            return false;
+        }
+        sha256Update(hash, buffer, n);
+        offset += n;
+    }
+
+    free(buffer);
+    return true;
+}
+
+/*
+*   Add the fingerprint of the file at path to hash: its device,
+*   inode, size and modification time, which change whenever its
+*   content is written. A missing file has a fingerprint too.
+*/
+void hashFingerprint(struct sha256Context* hash, const char* path)
+{
+    struct stat info;
+
+    hashText(hash, path);
+    if(stat(path, &info) == -1)
+    {
+        hashText(hash, "missing");
+        return;
+    }
+
+    sha256Update(hash, &info.st_dev, sizeof(info.st_dev));
+    sha256Update(hash, &info.st_ino, sizeof(info.st_ino));
+    sha256Update(hash, &info.st_size, sizeof(info.st_size));
+    sha256Update(hash, &info.st_mtim, sizeof(info.st_mtim));
+}
+
+/*
+*   Add the value of exported variable name to hash.
+*/
+void hashEnvironmentValue(struct shellContext* shell, struct sha256Context* hash, const char* name)
+{
+    const char* value = getEnvironmentValue(shell, name);
+
+    hashText(hash, name);
+    hashText(hash, value != NULL ? value : "\1unset");
+}
+
+/*
+*   Returns the store directory, $SMALLSH_CACHE or else
+*   $HOME/.cache/smallsh, made with its entries and blobs directories
+*   if it does not exist. The string is malloc'd.
+*/
+char* openCacheStore(struct shellContext* shell)
+{
+    const char* dir = getVariable(shell, "SMALLSH_CACHE");
+    const char* home = getVariable(shell, "HOME");
+    char path[PATH_MAX];
+    char* store;
+
+    if(dir != NULL && dir[0] != 0)
+    {
+        store = strdup(dir);
+    }
+    else
+    {
+        snprintf(path, sizeof(path), "%s/.cache", home != NULL ? home : ".");
+        mkdir(path, 0755);
+        snprintf(path, sizeof(path), "%s/.cache/smallsh", home != NULL ? home : ".");
+        store = strdup(path);
+    }
+
+    mkdir(store, 0755);
+    snprintf(path, sizeof(path), "%s/entries", store);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/blobs", store);
+    mkdir(path, 0755);
+
+    return store;
+}
+
+/*
+*   Put the content of fd in the store as a blob, unless a blob with
+*   that content is there already, and write its name to hex, of
+*   SHA256_HEX_SIZE chars. The
+*   blob is written under a temporary name and renamed, so a reader
+*   never sees part of one. Returns false if it could not be stored.
+*/
+bool storeBlob(const char* store, int fd, char* hex)
+{
+    struct sha256Context hash;
+    char path[PATH_MAX];
+    char temp[PATH_MAX];
+    off_t offset = 0;
+    int blobFD;
+    bool stored;
+
+    sha256Init(&hash);
+    if(!hashContent(fd, &hash))
+    {
+        return false;
+    }
+    sha256Hex(&hash, hex);
+    snprintf(path, sizeof(path), "%s/blobs/%s", store, hex);
+    if(access(path, F_OK) == 0)
+    {
+        return true;
+    }
+
+    snprintf(temp, sizeof(temp), "%s/blobs/.%s.%d", store, hex, getpid());
+    blobFD = open(temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(blobFD == -1)
+    {
+        return false;
+    }
+    stored = ioctl(blobFD, FICLONE, fd) == 0 || copyFD(fd, &offset, blobFD);
+    close(blobFD);
+
+    if(!stored || rename(temp, path) == -1)
+    {
+        unlink(temp);
+        return false;
+    }
+    return true;
+}
+
+/*
+*   Copy blob hex of the store to outFD, as a reflink if outFD is an
+*   empty file on the same filesystem. Returns false on an error.
+*/
+bool restoreBlob(const char* store, const char* hex, int outFD)
+{
+    char path[PATH_MAX];
+    off_t offset = 0;
+    int blobFD;
+    bool restored;
+
+    snprintf(path, sizeof(path), "%s/blobs/%s", store, hex);
+    blobFD = open(path, O_RDONLY | O_CLOEXEC);
+    if(blobFD == -1)
+    {
+        return false;
+    }
+    restored = ioctl(outFD, FICLONE, blobFD) == 0 || copyFD(blobFD, &offset, outFD);
+    close(blobFD);
+
+    return restored;
+}
+
+/*
+*   Write to key the key of a run of curCommand, the cache options
+*   removed:
+*   its words, the cwd, $PATH and the exported variables named in
+*   envNames, each redirection with the fingerprint of a < file or the
+*   content of a here-document, and the fingerprint of each file in
+*   deps, in hex of SHA256_HEX_SIZE chars. Sets *canCache to false for
+*   a >> redirection, whose result depends on what the file held
+*   before.
+*/
+void getCacheKey(struct shellContext* shell, struct commandElements* curCommand,
+    char** deps, int numDeps, char** envNames, int numEnvNames, char* key, bool* canCache)
+{
+    struct redirection* redirect;
+    struct sha256Context hash;
+    char cwd[PATH_MAX];
+    char* file;
+    int i;
+
+    sha256Init(&hash);
+    for(i = 0; i < curCommand->numArguments; i++)
+    {
+        hashText(&hash, curCommand->commands[i]);
+    }
+    hashText(&hash, getcwd(cwd, sizeof(cwd)) != NULL ? cwd : "");
+    hashEnvironmentValue(shell, &hash, "PATH");
+    for(i = 0; i < numEnvNames; i++)
+    {
+        hashEnvironmentValue(shell, &hash, envNames[i]);
+    }
+
+    *canCache = true;
+    for(i = 0; i < curCommand->numRedirections; i++)
+    {
+        redirect = &curCommand->redirections[i];
+        sha256Update(&hash, &redirect->type, sizeof(redirect->type));
+        sha256Update(&hash, &redirect->fd, sizeof(redirect->fd));
+        switch(redirect->type)
+        {
+            case REDIRECT_INPUT:
+                file = expandJoined(shell, redirect->word, &curCommand->expansion);
+                hashFingerprint(&hash, file);
+                break;
+            case REDIRECT_OUTPUT:
+                file = expandJoined(shell, redirect->word, &curCommand->expansion);
+                hashText(&hash, file);
+                break;
+            case REDIRECT_APPEND:
+                *canCache = false;
+                break;
+            case REDIRECT_HERE:
+                *canCache &= curCommand->inputFD != -1 && hashContent(curCommand->inputFD, &hash);
+                break;
+            case REDIRECT_DUP:
+                sha256Update(&hash, &redirect->sourceFD, sizeof(redirect->sourceFD));
+                break;
+            case REDIRECT_CLOSE:
+                break;
+        }
+    }
+
+    for(i = 0; i < numDeps; i++)
+    {
+        hashFingerprint(&hash, deps[i]);
+    }
+
+    sha256Hex(&hash, key);
+}
+
+/*
+*   Returns true if fd 1 of curCommand is redirected, so its stdout
+*   is not captured.
+*/
+bool isStdoutRedirected(struct commandElements* curCommand)
+{
+    int i;
+
+    for(i = 0; i < curCommand->numRedirections; i++)
+    {
+        if(curCommand->redirections[i].fd == 1)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+*   Returns true if manifest, the open entry of a key, has a status
+*   and every blob it names is in the store. It is read back to the
+*   start for restoreCacheEntry.
+*/
+bool isCacheEntryComplete(const char* store, FILE* manifest)
+{
+    char line[PATH_MAX + 96];
+    char hex[SHA256_HEX_SIZE];
+    char path[PATH_MAX];
+    struct stat info;
+    bool hasStatus = false;
+    bool isComplete = true;
+    int blobsFD;
+    int status;
+
+    snprintf(path, sizeof(path), "%s/blobs", store);
+    blobsFD = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(blobsFD == -1)
+    {
+        return false;
+    }
+
+    while(isComplete && fgets(line, sizeof(line), manifest) != NULL)
+    {
+        if(sscanf(line, "status %d", &status) == 1)
+        {
+            hasStatus = true;
+        }
+        else if(sscanf(line, "stdout %64s", hex) == 1 || sscanf(line, "file %64s", hex) == 1)
+        {
+            isComplete = fstatat(blobsFD, hex, &info, 0) == 0;
+        }
+    }
+    close(blobsFD);
+    rewind(manifest);
+
+    return isComplete && hasStatus;
+}
+
+/*
+*   Restore the results of a run from manifest, the open entry of
+*   curCommand: stdout, then the files written, then the exit status.
+*   Nothing is written unless every blob is there, so a missing blob
+*   is a miss and the run that follows does not repeat output. Returns
+*   false on a miss.
+*/
+bool restoreCacheEntry(struct shellContext* shell, const char* store, FILE* manifest)
+{
+    char line[PATH_MAX + 96];
+    char hex[SHA256_HEX_SIZE];
+    int pathStart = 0;
+    int status = -1;
+    int fd;
+    bool restored = true;
+
+    if(!isCacheEntryComplete(store, manifest))
+    {
+        return false;
+    }
+
+    fflush(stdout);
+    while(restored && fgets(line, sizeof(line), manifest) != NULL)
+    {
+        line[strcspn(line, "\n")] = 0;
+        if(sscanf(line, "status %d", &status) == 1)
+        {
+            continue;
+        }
+        if(sscanf(line, "stdout %64s", hex) == 1)
+        {
+            restored = restoreBlob(store, hex, STDOUT_FILENO);
+        }
+        else if(sscanf(line, "file %64s %n", hex, &pathStart) == 1 && pathStart > 0)
+        {
+            fd = open(line + pathStart, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            restored = fd != -1 && restoreBlob(store, hex, fd);
+            if(fd != -1)
+            {
+                close(fd);
+            }
+        }
+    }
+
+    if(!restored || status == -1)
+    {
+        return false;
+    }
+    sprintf(shell->exitStatus, "exit value %d", status);
+    return true;
+}
+
+/*
+*   Store the results of the run of curCommand that just ended under
+*   key: the exit status, stdout captured in stdoutFD if it is not -1,
+*   and the content of each file a > redirection wrote. A run ended
+*   by a signal or a timeout is not stored.
+*/
+void storeCacheEntry(struct shellContext* shell, const char* store, const char* key,
+    struct commandElements* curCommand, int stdoutFD)
+{
+    char path[PATH_MAX];
+    char temp[PATH_MAX];
+    char hex[SHA256_HEX_SIZE];
+    FILE* manifest;
+    char* file;
+    bool stored = true;
+    int status;
+    int fd;
+    int i;
+
+    if(sscanf(shell->exitStatus, "exit value %d", &status) != 1)
+    {
+        return;
+    }
+
+    snprintf(path, sizeof(path), "%s/entries/%s", store, key);
+    snprintf(temp, sizeof(temp), "%s/entries/.%s.%d", store, key, getpid());
+    manifest = fopen(temp, "we");
+    if(manifest == NULL)
+    {
+        return;
+    }
+
+    fprintf(manifest, "status %d\n", status);
+    if(stdoutFD != -1)
+    {
+        stored = storeBlob(store, stdoutFD, hex);
+        fprintf(manifest, "stdout %s\n", hex);
+    }
+    for(i = 0; stored && i < curCommand->numRedirections; i++)
+    {
+        if(curCommand->redirections[i].type != REDIRECT_OUTPUT)
+        {
+            continue;
+        }
+        file = expandJoined(shell, curCommand->redirections[i].word, &curCommand->expansion);
+        fd = open(file, O_RDONLY | O_CLOEXEC);
+        stored = fd != -1 && storeBlob(store, fd, hex);
+        fprintf(manifest, "file %s %s\n", hex, file);
+        if(fd != -1)
+        {
+            close(fd);
+        }
+    }
+
+    if(fclose(manifest) != 0 || !stored || rename(temp, path) == -1)
+    {
+        unlink(temp);
+    }
+}
+
+/*
+*   Run curCommand, the cache options removed, on a miss. Its stdout,
+*   if not redirected, goes to a memory file that is stored and then
+*   copied to the shell's stdout. The capture is the first planned op,
+*   so a 2>&1 after it is captured too.
+*/
+void runCachedCommand(struct shellContext* shell, const char* store, const char* key,
+    struct commandElements* curCommand)
+{
+    int stdoutFD = -1;
+    off_t offset = 0;
+
+    if(!planRedirections(shell, curCommand))
+    {
+        strcpy(shell->exitStatus, "exit value 1");
+        return;
+    }
+
+    if(!isStdoutRedirected(curCommand))
+    {
+        stdoutFD = moveToPlannedFD(memfd_create("smallsh-cache", MFD_CLOEXEC));
+        if(stdoutFD != -1)
+        {
+            memmove(curCommand->plan + 1, curCommand->plan, curCommand->numPlanned * sizeof(struct redirectOp));
+            curCommand->numPlanned++;
+            curCommand->plan[0].fd = STDOUT_FILENO;
+            curCommand->plan[0].sourceFD = stdoutFD;
+            curCommand->plan[0].opened = false;
+        }
+    }
+
+    runFGProcess(shell, curCommand);
+
+    if(stdoutFD != -1)
+    {
+        fflush(stdout);
+        copyFD(stdoutFD, &offset, STDOUT_FILENO);
+    }
+    storeCacheEntry(shell, store, key, curCommand, stdoutFD);
+    if(stdoutFD != -1)
+    {
+        close(stdoutFD);
+    }
+}
+
+/*
+*   Print the hits and misses of this shell and the size of the
+*   store.
+*/
+void printCacheStats(struct shellContext* shell, const char* store)
+{
+    struct cacheStats* stats = &shell->cacheStats;
+    char path[PATH_MAX];
+    struct dirent* entry;
+    struct stat info;
+    long long numBytes = 0;
+    long numEntries = 0;
+    long numBlobs = 0;
+    long numRuns = stats->hits + stats->misses;
+    DIR* dir;
+
+    snprintf(path, sizeof(path), "%s/entries", store);
+    if((dir = opendir(path)) != NULL)
+    {
+        while((entry = readdir(dir)) != NULL)
+        {
+            numEntries += entry->d_name[0] != '.';
+        }
+        closedir(dir);
+    }
+    snprintf(path, sizeof(path), "%s/blobs", store);
+    if((dir = opendir(path)) != NULL)
+    {
+        while((entry = readdir(dir)) != NULL)
+        {
+            if(entry->d_name[0] != '.' && fstatat(dirfd(dir), entry->d_name, &info, 0) == 0)
+            {
+                numBlobs++;
+                numBytes += info.st_size;
+            }
+        }
+        closedir(dir);
+    }
+
+    printf("cache: %ld hits, %ld misses, %ld not cached, hit rate %ld%%\n", stats->hits,
+        stats->misses, stats->uncached, numRuns > 0 ? stats->hits * 100 / numRuns : 0);
+    printf("cache: %ld entries, %ld blobs, %lld bytes in %s\n", numEntries, numBlobs, numBytes, store);
+    fflush(stdout);
+}
+
+/*
+*   Runs the built in command cache [-d PATH]... [-e NAME]... COMMAND
+*   [ARG]... COMMAND is run as a program, keyed by its words, the cwd,
+*   $PATH and each exported NAME, its redirections with the
+*   fingerprint of each < file, and the fingerprint of each PATH it
+*   depends on. The first run stores its stdout, the files its >
+*   redirections write and its exit status, and a run with the same
+*   key restores them without running it. A command with >>, or run
+*   with &, is run without the cache. cache --stats prints the hit
+*   rate and the size of the store.
+*/
+void runCacheCommand(struct shellContext* shell, struct commandElements* curCommand)
+{
+    char* deps[MAX_COMMAND_LINE_ARGUMENTS];
+    char* envNames[MAX_COMMAND_LINE_ARGUMENTS];
+    char path[PATH_MAX];
+    char key[SHA256_HEX_SIZE];
+    int numDeps = 0;
+    int numEnvNames = 0;
+    FILE* manifest;
+    bool canCache;
+    char* store;
+    int i = 1;
+
+    store = openCacheStore(shell);
+    if(curCommand->numArguments == 2 && strcmp(curCommand->commands[1], "--stats") == 0)
+    {
+        printCacheStats(shell, store);
+        strcpy(shell->exitStatus, "exit value 0");
+        free(store);
+        return;
+    }
+
+    while(i + 1 < curCommand->numArguments && (strcmp(curCommand->commands[i], "-d") == 0 ||
+        strcmp(curCommand->commands[i], "-e") == 0))
+    {
+        if(curCommand->commands[i][1] == 'd')
+        {
+            deps[numDeps++] = curCommand->commands[i + 1];
+        }
+        else
+        {
+            envNames[numEnvNames++] = curCommand->commands[i + 1];
+        }
+        i += 2;
+    }
+    if(i < curCommand->numArguments && strcmp(curCommand->commands[i], "--") == 0)
+    {
+        i++;
+    }
+    if(i >= curCommand->numArguments)
+    {
+        fprintf(stderr, "usage: cache [-d PATH]... [-e NAME]... COMMAND [ARG]... | cache --stats\n");
+        fflush(stderr);
+        strcpy(shell->exitStatus, "exit value 2");
+        free(store);
+        return;
+    }
+
+    // Run the words after the options as the command, with its NULL
+    memmove(curCommand->commands, curCommand->commands + i,
+        (curCommand->numArguments - i + 1) * sizeof(char*));
+    curCommand->numArguments -= i;
+
+    getCacheKey(shell, curCommand, deps, numDeps, envNames, numEnvNames, key, &canCache);
+    if(!canCache || curCommand->bg)
+    {
+        shell->cacheStats.uncached++;
+        runOtherCommands(shell, curCommand);
+        free(store);
+        return;
+    }
+
+    snprintf(path, sizeof(path), "%s/entries/%s", store, key);
+    manifest = fopen(path, "re");
+    if(manifest != NULL && restoreCacheEntry(shell, store, manifest))
+    {
+        shell->cacheStats.hits++;
+    }
+    else
+    {
+        shell->cacheStats.misses++;
+        runCachedCommand(shell, store, key, curCommand);
+    }
+    if(manifest != NULL)
+    {
+        fclose(manifest);
+    }
+    free(store);
+}
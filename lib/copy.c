@@ -0,0 +1,378 @@
+/*
+*   The cat and tee built ins. Data is moved inside the kernel where
+*   the two files allow it: copy_file_range between regular files,
+*   splice when either side is a pipe, and sendfile from a regular
+*   file to anything else, with a large buffer loop for the rest. No
+*   process is started and the data is not copied through the shell.
+*   SIGINT, which the shell ignores, is caught while they run so
+*   Ctrl-C stops them as it would a cat that is a child. They take no
+*   options but tee's -a, a command with any other is run by exec.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+#include "smallsh.h"
+
+#define COPY_CHUNK (1 << 30)        // bytes asked for by one kernel copy
+#define COPY_BUFFER_SIZE (128 * 1024)
+
+// Set by SIGINT, which stops a copy of cat or tee
+volatile sig_atomic_t copyInterrupted = 0;
+
+/*
+*   Handle SIGINT while cat or tee copies.
+*/
+void handleCopySIGINT(int signo)
+{
+    (void)signo;
+    copyInterrupted = 1;
+}
+
+/*
+*   Catch SIGINT for a copy of cat or tee, saving the action it had in
+*   saved. Without SA_RESTART a read from a terminal or pipe returns,
+*   and each copy loop stops once the flag is set.
+*/
+void catchCopySIGINT(struct sigaction* saved)
+{
+    struct sigaction action = {0};
+
+    copyInterrupted = 0;
+    action.sa_handler = handleCopySIGINT;
+    sigfillset(&action.sa_mask);
+    action.sa_flags = 0;
+    sigaction(SIGINT, &action, saved);
+}
+
+/*
+*   Put back the SIGINT action saved by catchCopySIGINT. Returns true
+*   if SIGINT stopped the copy.
+*/
+bool releaseCopySIGINT(const struct sigaction* saved)
+{
+    bool interrupted;
+
+    sigaction(SIGINT, saved, NULL);
+    interrupted = copyInterrupted;
+    copyInterrupted = 0;
+
+    return interrupted;
+}
+
+/*
+*   Returns true, with errno set to EINTR, if SIGINT stopped the copy.
+*/
+bool isCopyInterrupted()
+{
+    if(copyInterrupted)
+    {
+        errno = EINTR;
+        return true;
+    }
+
+    return false;
+}
+
+/*
+*   Returns true if errno after a failed kernel copy means the method
+*   does not work for these fds, so the next one should be tried.
+*/
+bool isCopyUnsupported()
+{
+    return errno == EINVAL || errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP ||
+        errno == EBADF || errno == ESPIPE;
+}
+
+/*
+*   Copy inFD to outFD with read and write through a buffer, reading
+*   at *offset and moving it if offset is not NULL. Returns false on
+*   an error, with errno set.
+*/
+bool copyWithBuffer(int inFD, off_t* offset, int outFD)
+{
+    char* buffer = malloc(COPY_BUFFER_SIZE);
+    ssize_t numRead;
+    ssize_t numWritten;
+    ssize_t n;
+
+    while(!isCopyInterrupted())
+    {
+        numRead = offset != NULL ? pread(inFD, buffer, COPY_BUFFER_SIZE, *offset) :
+            read(inFD, buffer, COPY_BUFFER_SIZE);
+        if(numRead == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if(numRead <= 0)
+        {
+            break;
+        }
+        if(offset != NULL)
+        {
+            *offset += numRead;
+        }
+
+        for(numWritten = 0; numWritten < numRead; numWritten += n)
+        {
+            n = write(outFD, buffer + numWritten, numRead - numWritten);
+            if(n == -1 && errno != EINTR)
+            {
+                free(buffer);
+                return false;
+            }
+            n = n == -1 ? 0 : n;
+        }
+    }
+
+    free(buffer);
+    return numRead == 0 && !isCopyInterrupted();
+}
+
+/*
+*   Copy the rest of inFD to outFD, from *offset if offset is not NULL
+*   or else from its file position. The first of copy_file_range,
+*   splice and sendfile the two fds allow is used, and the buffer loop
+*   if none is. Returns false on an error, with errno set.
+*/
+bool copyFD(int inFD, off_t* offset, int outFD)
+{
+    struct stat in;
+    struct stat out;
+    bool useRange;
+    bool useSplice;
+    bool useSendfile;
+    ssize_t n = -1;
+
+    if(fstat(inFD, &in) == -1 || fstat(outFD, &out) == -1)
+    {
+        return false;
+    }
+    useRange = S_ISREG(in.st_mode) && S_ISREG(out.st_mode);
+    useSplice = S_ISFIFO(in.st_mode) || S_ISFIFO(out.st_mode);
+    useSendfile = S_ISREG(in.st_mode);
+
+    // A pipe has no offset, splice must be given NULL for it
+    if(S_ISFIFO(in.st_mode))
+    {
+        offset = NULL;
+    }
+
+    while(useRange || useSplice || useSendfile)
+    {
+        if(isCopyInterrupted())
+        {
+            return false;
+        }
+        if(useRange)
+        {
+            n = copy_file_range(inFD, offset, outFD, NULL, COPY_CHUNK, 0);
+        }
+        else if(useSplice)
+        {
+            n = splice(inFD, offset, outFD, NULL, COPY_CHUNK, SPLICE_F_MOVE);
+        }
+        else
+        {
+            n = sendfile(outFD, inFD, offset, COPY_CHUNK);
+        }
+
+        if(n == 0)
+        {
+            return true;
+        }
+        if(n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n == -1 && !isCopyUnsupported())
+        {
+            return false;
+        }
+        if(n == -1)
+        {
+            // Nothing was copied by this method, try the next one
+            useSendfile = useSendfile && (useRange || useSplice);
+            useRange = useSplice = false;
+        }
+    }
+
+    return copyWithBuffer(inFD, offset, outFD);
+}
+
+/*
+*   Returns true if curCommand, cat or tee, has an option the built
+*   in does not take: an argument starting with - other than - itself,
+*   or -a as the first argument of tee.
+*/
+bool hasCopyOptions(struct commandElements* curCommand)
+{
+    bool isTee = strcmp(curCommand->commands[0], "tee") == 0;
+    const char* argument;
+    int i;
+
+    for(i = 1; i < curCommand->numArguments; i++)
+    {
+        argument = curCommand->commands[i];
+        if(argument[0] == '-' && argument[1] != '\0' &&
+            !(isTee && i == 1 && strcmp(argument, "-a") == 0))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+*   Runs the built in command cat [FILE]... Each FILE, or stdin for
+*   none or for -, is copied to stdout in order. A FILE that can not
+*   be read is reported and skipped, and the status is then 1.
+*/
+void runCatCommand(struct shellContext* shell, struct commandElements* curCommand)
+{
+    const char* file;
+    int fd;
+    int i = 1;
+
+    strcpy(shell->exitStatus, "exit value 0");
+    fflush(stdout);
+
+    do
+    {
+        file = i < curCommand->numArguments ? curCommand->commands[i] : "-";
+        fd = strcmp(file, "-") == 0 ? STDIN_FILENO : open(file, O_RDONLY | O_CLOEXEC);
+        if(fd == -1 || !copyFD(fd, NULL, STDOUT_FILENO))
+        {
+            // Like a cat killed by SIGPIPE or SIGINT, a closed reader
+            // or Ctrl-C is not reported
+            if(isCopyInterrupted())
+            {
+                break;
+            }
+            if(errno != EPIPE)
+            {
+                fprintf(stderr, "cat: %s: %s\n", file, strerror(errno));
+                fflush(stderr);
+            }
+            strcpy(shell->exitStatus, "exit value 1");
+        }
+        if(fd != -1 && fd != STDIN_FILENO)
+        {
+            close(fd);
+        }
+        i++;
+    }
+    while(i < curCommand->numArguments);
+}
+
+/*
+*   Runs the built in command tee [-a] [FILE]... stdin is copied to
+*   stdout and to each FILE, appended to with -a. A regular file on
+*   stdin is copied to each output in turn from the same offset, so
+*   every copy can be made in the kernel. Other input is read once
+*   through a buffer and written to all of them.
+*/
+void runTeeCommand(struct shellContext* shell, struct commandElements* curCommand)
+{
+    int outputs[MAX_COMMAND_LINE_ARGUMENTS];
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    char* buffer;
+    struct stat in;
+    off_t start;
+    off_t offset;
+    ssize_t numRead;
+    ssize_t numWritten;
+    ssize_t n;
+    int numOutputs = 0;
+    int i = 1;
+
+    strcpy(shell->exitStatus, "exit value 0");
+    fflush(stdout);
+
+    if(i < curCommand->numArguments && strcmp(curCommand->commands[i], "-a") == 0)
+    {
+        flags = O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC;
+        i++;
+    }
+
+    outputs[numOutputs++] = STDOUT_FILENO;
+    for(; i < curCommand->numArguments; i++)
+    {
+        outputs[numOutputs] = open(curCommand->commands[i], flags, 0644);
+        if(outputs[numOutputs] == -1)
+        {
+            fprintf(stderr, "tee: %s: %s\n", curCommand->commands[i], strerror(errno));
+            fflush(stderr);
+            strcpy(shell->exitStatus, "exit value 1");
+            continue;
+        }
+        numOutputs++;
+    }
+
+    start = lseek(STDIN_FILENO, 0, SEEK_CUR);
+    if(fstat(STDIN_FILENO, &in) == 0 && S_ISREG(in.st_mode) && start != -1)
+    {
+        for(i = 0; i < numOutputs && !isCopyInterrupted(); i++)
+        {
+            offset = start;
+            if(!copyFD(STDIN_FILENO, &offset, outputs[i]))
+            {
+                strcpy(shell->exitStatus, "exit value 1");
+            }
+        }
+        lseek(STDIN_FILENO, offset, SEEK_SET);
+    }
+    else
+    {
+        buffer = malloc(COPY_BUFFER_SIZE);
+        while(!isCopyInterrupted() && (numRead = read(STDIN_FILENO, buffer, COPY_BUFFER_SIZE)) != 0)
+        {
+            if(numRead == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            if(numRead == -1)
+            {
+                strcpy(shell->exitStatus, "exit value 1");
+                break;
+            }
+
+            // An output that fails is dropped, the others go on
+            for(i = 0; i < numOutputs; i++)
+            {
+                for(numWritten = 0; outputs[i] != -1 && numWritten < numRead; numWritten += n)
+                {
+                    n = write(outputs[i], buffer + numWritten, numRead - numWritten);
+                    if(n == -1 && errno != EINTR)
+                    {
+                        strcpy(shell->exitStatus, "exit value 1");
+                        if(i > 0)
+                        {
+                            close(outputs[i]);
+                        }
+                        outputs[i] = -1;
+                    }
+                    n = n == -1 ? 0 : n;
+                }
+            }
+        }
+        free(buffer);
+    }
+
+    for(i = 1; i < numOutputs; i++)
+    {
+        if(outputs[i] != -1)
+        {
+            close(outputs[i]);
+        }
+    }
+}
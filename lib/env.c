@@ -0,0 +1,254 @@
+/*
+*   Environment of children. Exported variables are kept as a NULL
+*   terminated envp vector that is always ready for exec, with the
+*   slot of each name in a hash table, so a change to an exported
+*   variable is made in place and a launch copies nothing.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "smallsh.h"
+
+extern char** environ;
+
+/*
+*   Returns the slot of name, the first len chars of name, in the
+*   environment of shell, or -1 if it is not exported.
+*/
+int findEnvironmentSlot(struct shellContext* shell, const char* name, int len)
+{
+    char key[len + 1];
+
+    memcpy(key, name, len);
+    key[len] = 0;
+
+    return (int)(intptr_t)hashLookup(&shell->environment.slots, key) - 1;
+}
+
+/*
+*   Record slot as the slot of the "NAME=value" entry in the
+*   environment of shell.
+*/
+void indexEnvironmentEntry(struct shellContext* shell, const char* entry, int slot)
+{
+    int len = strchr(entry, '=') - entry;
+    char key[len + 1];
+
+    memcpy(key, entry, len);
+    key[len] = 0;
+    hashInsert(&shell->environment.slots, key, (void*)(intptr_t)(slot + 1));
+}
+
+/*
+*   Put entry, a malloc'd "NAME=value" string, in the environment of
+*   shell. It replaces the entry for NAME in its slot, or is added at
+*   the end.
+*/
+void setEnvironmentEntry(struct shellContext* shell, char* entry)
+{
+    struct environment* env = &shell->environment;
+    int len = strchr(entry, '=') - entry;
+    int slot = findEnvironmentSlot(shell, entry, len);
+
+    if(slot != -1)
+    {
+        free(env->envp[slot]);
+        env->envp[slot] = entry;
+        return;
+    }
+
+    // Room for the entry and the NULL after it
+    if(env->numEntries + 2 > env->capacity)
+    {
+        env->capacity = env->capacity ? env->capacity * 2 : 64;
+        env->envp = realloc(env->envp, env->capacity * sizeof(char*));
+    }
+    env->envp[env->numEntries] = entry;
+    env->envp[env->numEntries + 1] = NULL;
+    indexEnvironmentEntry(shell, entry, env->numEntries);
+    env->numEntries++;
+}
+
+/*
+*   Copy the environment the shell was started with into the envp
+*   vector of shell.
+*/
+void initializeEnvironment(struct shellContext* shell)
+{
+    char** entry;
+
+    for(entry = environ; *entry != NULL; entry++)
+    {
+        if(strchr(*entry, '=') != NULL)
+        {
+            setEnvironmentEntry(shell, strdup(*entry));
+        }
+    }
+    if(shell->environment.envp == NULL)
+    {
+        shell->environment.capacity = 1;
+        shell->environment.envp = calloc(1, sizeof(char*));
+    }
+}
+
+/*
+*   Returns value of name in the environment of shell, or NULL if it
+*   is not exported.
+*/
+const char* getEnvironmentValue(struct shellContext* shell, const char* name)
+{
+    int len = strlen(name);
+    int slot = findEnvironmentSlot(shell, name, len);
+
+    return slot != -1 ? shell->environment.envp[slot] + len + 1 : NULL;
+}
+
+/*
+*   Export name with value, replacing the value it had if it is
+*   already exported.
+*/
+void exportVariable(struct shellContext* shell, const char* name, const char* value)
+{
+    int nameLen = strlen(name);
+    int valueLen = strlen(value);
+    char* entry = malloc(nameLen + valueLen + 2);
+
+    memcpy(entry, name, nameLen);
+    entry[nameLen] = '=';
+    memcpy(entry + nameLen + 1, value, valueLen + 1);
+    setEnvironmentEntry(shell, entry);
+}
+
+/*
+*   Take name out of the environment of shell. The last entry is moved
+*   into its slot.
+*/
+void unexportVariable(struct shellContext* shell, const char* name)
+{
+    struct environment* env = &shell->environment;
+    int slot = (int)(intptr_t)hashRemove(&env->slots, name) - 1;
+    char* last;
+
+    if(slot == -1)
+    {
+        return;
+    }
+
+    free(env->envp[slot]);
+    env->numEntries--;
+    last = env->envp[env->numEntries];
+    env->envp[env->numEntries] = NULL;
+    if(slot != env->numEntries)
+    {
+        env->envp[slot] = last;
+        indexEnvironmentEntry(shell, last, slot);
+    }
+}
+
+/*
+*   In a child about to exec curCommand, put the NAME=value
+*   assignments written before the command in the envp vector. The
+*   child has its own copy, so nothing is undone and nothing is
+*   copied for commands without assignments. environ is pointed at
+*   the vector so the $PATH search of exec uses it too.
+*/
+void overlayEnvironment(struct shellContext* shell, struct commandElements* curCommand)
+{
+    int i;
+
+    for(i = 0; i < curCommand->numAssignments; i++)
+    {
+        setEnvironmentEntry(shell, curCommand->overlay[i]);
+    }
+    environ = shell->environment.envp;
+}
+
+/*
+*   Runs the built in command export. "export NAME=value" sets and
+*   exports a variable, "export NAME" exports the value it has. With
+*   no names the environment is printed.
+*/
+void runExportCommand(struct shellContext* shell, struct commandElements* curCommand)
+{
+    const char* value;
+    char* equals;
+    char* name;
+    int i;
+
+    strcpy(shell->exitStatus, "exit value 0");
+
+    if(curCommand->numArguments == 1 ||
+        (curCommand->numArguments == 2 && strcmp(curCommand->commands[1], "-p") == 0))
+    {
+        for(i = 0; i < shell->environment.numEntries; i++)
+        {
+            printf("export %s\n", shell->environment.envp[i]);
+        }
+        fflush(stdout);
+        return;
+    }
+
+    for(i = 1; i < curCommand->numArguments; i++)
+    {
+        equals = strchr(curCommand->commands[i], '=');
+        name = equals != NULL ? strndup(curCommand->commands[i], equals - curCommand->commands[i]) :
+            strdup(curCommand->commands[i]);
+        if(name[0] == 0 || variableNameLength(name) != (int)strlen(name))
+        {
+            fprintf(stderr, "export: %s: not a valid name\n", curCommand->commands[i]);
+            fflush(stderr);
+            strcpy(shell->exitStatus, "exit value 1");
+            free(name);
+            continue;
+        }
+
+        if(equals != NULL)
+        {
+            setVariable(shell, name, equals + 1);
+        }
+        value = getVariable(shell, name);
+        exportVariable(shell, name, value != NULL ? value : "");
+        free(name);
+    }
+}
+
+/*
+*   Runs the built in command unset. "unset NAME" removes the variable
+*   and its export, "unset -x NAME" only stops exporting it.
+*/
+void runUnsetCommand(struct shellContext* shell, struct commandElements* curCommand)
+{
+    const char* value;
+    bool keepVariable = false;
+    int i = 1;
+
+    if(curCommand->numArguments > 1 && strcmp(curCommand->commands[1], "-x") == 0)
+    {
+        keepVariable = true;
+        i++;
+    }
+
+    for(; i < curCommand->numArguments; i++)
+    {
+        if(keepVariable)
+        {
+            // A variable only in the environment stays a shell variable
+            value = getEnvironmentValue(shell, curCommand->commands[i]);
+            if(value != NULL && hashLookup(&shell->variables, curCommand->commands[i]) == NULL)
+            {
+                hashInsert(&shell->variables, curCommand->commands[i], strdup(value));
+            }
+        }
+        else
+        {
+            free(hashRemove(&shell->variables, curCommand->commands[i]));
+        }
+        unexportVariable(shell, curCommand->commands[i]);
+    }
+
+    strcpy(shell->exitStatus, "exit value 0");
+}
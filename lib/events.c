@@ -0,0 +1,145 @@
+/*
+*   The shell's event loop. Waiting for a foreground child or for
+*   input is a poll that also fires the deadlines of timeouts and
+*   drains the output of background jobs into their logs, so neither
+*   needs a loop that checks on them.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "smallsh.h"
+
+/*
+*   Returns true if there is anything for the event loop to watch
+*   besides what is waited for.
+*/
+bool hasShellEvents(struct shellContext* shell)
+{
+    return (shell->deadlines.numEntries > 0 && shell->timerFD != -1) ||
+        shell->jobLogs.numOpen > 0;
+}
+
+/*
+*   Wait until one of the numWaited fds in waited can be read, firing
+*   deadlines and draining job output meanwhile. An fd of -1 is
+*   skipped. Returns the index of the first ready fd, 0 if poll
+*   fails, or -1 if a signal interrupted the wait or tagged job output
+*   was printed, so a caller showing a line can show it again.
+*/
+int waitForEvents(struct shellContext* shell, const int* waited, int numWaited)
+{
+    struct pollfd* fds = malloc((numWaited + shell->jobLogs.numLogs + 1) * sizeof(struct pollfd));
+    struct jobLog* log;
+    int ready = -1;
+    bool printed = false;
+    int numFDs;
+    int i;
+
+    while(ready == -1 && !printed)
+    {
+        for(i = 0; i < numWaited; i++)
+        {
+            fds[i].fd = waited[i];
+            fds[i].events = POLLIN;
+        }
+        fds[numWaited].fd = shell->timerFD;
+        fds[numWaited].events = POLLIN;
+        numFDs = numWaited + 1;
+        for(i = 0; i < shell->jobLogs.numLogs; i++)
+        {
+            fds[numFDs].fd = shell->jobLogs.logs[i].fd;
+            fds[numFDs].events = POLLIN;
+            numFDs++;
+        }
+
+        if(poll(fds, numFDs, -1) == -1)
+        {
+            if(errno != EINTR)
+            {
+                ready = 0;
+            }
+            break;
+        }
+
+        if(fds[numWaited].revents & POLLIN)
+        {
+            fireDeadlines(shell);
+        }
+        for(i = numWaited + 1; i < numFDs; i++)
+        {
+            log = &shell->jobLogs.logs[i - numWaited - 1];
+            if(fds[i].revents != 0 && log->fd == fds[i].fd)
+            {
+                printed |= drainJobLog(shell, log);
+            }
+        }
+        for(i = numWaited - 1; i >= 0; i--)
+        {
+            if(fds[i].revents != 0)
+            {
+                ready = i;
+            }
+        }
+    }
+
+    free(fds);
+    return ready;
+}
+
+/*
+*   Wait until fd can be read, running the event loop meanwhile.
+*   Returns false if the wait was cut short, as waitForEvents.
+*/
+bool waitForEvent(struct shellContext* shell, int fd)
+{
+    return waitForEvents(shell, &fd, 1) != -1;
+}
+
+/*
+*   Wait for child pid like waitpid, running the event loop while
+*   waiting. The child is watched with a pidfd. With nothing else to
+*   watch this is a plain waitpid. A wait cut short by SIGTSTP, which
+*   does not restart it, is waited again.
+*/
+pid_t waitForChild(struct shellContext* shell, pid_t pid, int* status)
+{
+    pid_t waitedPID;
+    int pidFD;
+
+    pidFD = hasShellEvents(shell) ? syscall(SYS_pidfd_open, pid, 0) : -1;
+    while(pidFD != -1 && !waitForEvent(shell, pidFD) && hasShellEvents(shell))
+    {
+    }
+    if(pidFD != -1)
+    {
+        close(pidFD);
+    }
+
+    while((waitedPID = waitpid(pid, status, 0)) == -1 && errno == EINTR)
+    {
+    }
+
+    return waitedPID;
+}
+
+/*
+*   Wait until the script can be read, running the event loop while
+*   waiting. Returns false if the wait was cut short by a signal or by
+*   printed job output.
+*/
+bool waitForInput(struct shellContext* shell)
+{
+    if(!hasShellEvents(shell))
+    {
+        return true;
+    }
+
+    return waitForEvent(shell, shell->scriptFD);
+}
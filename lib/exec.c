@@ -0,0 +1,1359 @@
+/*
+*   Running commands: built ins, functions, aliases, and other
+*   commands in foreground and background children.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "smallsh.h"
+
+const char* builtInCommands[NUM_BUILT_INS] = {"exit", "cd", "status", "alias", "unalias",
+    "timeout", "joblog", "export", "unset", "onchange", "cat", "tee",
+    "exec", "cache", "let"};
+
+/*
+*   Runs the built in command cd by changing either to HOME or an
+*   assigned directory. Returns false if the directory could not be
+*   changed.
+*/
+bool runCdCommand(struct shellContext* shell, struct commandElements* curCommand)
+{
+    char cwd[256];
+    char path[256];
+    int result;
+
+    // If no arguments after cd
+    if(curCommand->numArguments == 1)
+    {
+        // Then change to HOME directory
+        getcwd(cwd, sizeof(cwd));
+        result = chdir(getVariable(shell, "HOME"));
+        getcwd(cwd, sizeof(cwd));
+    }
+    // If there is an argument, then change to this
+    // directory. Command should support both absolute
+    // and relative paths.
+    else
+    {
+        // Get path, which is argument after cd
+        strcpy(path, curCommand->commands[1]);
+        // If absolute, first char is '/', then chdir
+        // with path
+        char firstChar = path[0];
+        if(firstChar == '/')
+        {
+            getcwd(cwd, sizeof(cwd));
+            result = chdir(path);
+            getcwd(cwd, sizeof(cwd));
+        }
+        // If relative, first get cwd, add '/',
+        // concatenate relative path, then chdir to path
+        else
+        {
+            getcwd(cwd, sizeof(cwd));
+            strcat(cwd, "/");
+            strcat(cwd, path);
+            strcpy(path, cwd); // Did this as path is a better var name
+            result = chdir(path);
+            getcwd(cwd, sizeof(cwd));
+        }
+    }
+
+    if(result == -1)
+    {
+        fprintf(stderr, "cd: %s: %s\n", curCommand->numArguments == 1 ? "HOME" :
+            curCommand->commands[1], strerror(errno));
+        fflush(stderr);
+    }
+
+    return result == 0;
+}
+
+/*
+*   Free body, a function or alias body that was replaced or removed.
+*   While a command is running the body may be what runs it, so it is
+*   kept in a group node until the outermost command returns.
+*/
+void retireNodeList(struct shellContext* shell, struct commandNode* body)
+{
+    struct commandNode* group;
+
+    if(body == NULL)
+    {
+        return;
+    }
+    if(shell->commandDepth == 0)
+    {
+        freeNodeList(body);
+        return;
+    }
+
+    group = calloc(1, sizeof(struct commandNode));
+    group->type = NODE_GROUP;
+    group->body = body;
+    group->next = shell->retiredBodies;
+    shell->retiredBodies = group;
+}
+
+/*
+*   Free an alias, its parsed body once nothing runs it.
+*/
+void freeAlias(struct shellContext* shell, struct shellAlias* alias)
+{
+    if(alias != NULL)
+    {
+        free(alias->text);
+        retireNodeList(shell, alias->body);
+        free(alias);
+    }
+}
+
+/*
+*   Runs the built in command alias. With no arguments all aliases
+*   are printed. "alias NAME=TEXT" defines an alias, the text is parsed
+*   once here. The text is taken from the words as parsed, so it is
+*   expanded when the alias is used. Quotes around the text are taken
+*   off, the text may have spaces. "alias NAME" prints one alias.
+*/
+void runAliasCommand(struct shellContext* shell, struct commandElements* curCommand)
+{
+    struct shellAlias* alias;
+    struct hashEntry* entry;
+    char* definition = NULL;
+    char* equals;
+    char* text;
+    int definitionLen = 0;
+    int i, len;
+
+    if(curCommand->numArguments == 1)
+    {
+        for(i = 0; i < shell->aliases.numBuckets; i++)
+        {
+            for(entry = shell->aliases.buckets[i]; entry != NULL; entry = entry->next)
+            {
+                printf("alias %s='%s'\n", entry->key, ((struct shellAlias*)entry->value)->text);
+            }
+        }
+        fflush(stdout);
+        return;
+    }
+
+    // Text may have been split into several words
+    for(i = 1; i < curCommand->numWords; i++)
+    {
+        appendToField(&definition, &definitionLen, i > 1 ? " " : "", i > 1);
+        appendToField(&definition, &definitionLen, curCommand->words[i],
+            strlen(curCommand->words[i]));
+    }
+
+    equals = strchr(definition, '=');
+    if(equals == NULL)
+    {
+        alias = hashLookup(&shell->aliases, definition);
+        if(alias != NULL)
+        {
+            printf("alias %s='%s'\n", definition, alias->text);
+        }
+        else
+        {
+            printf("alias: %s: not found\n", definition);
+        }
+        fflush(stdout);
+        free(definition);
+        return;
+    }
+
+    *equals = 0;
+    text = equals + 1;
+    len = strlen(text);
+    if(len >= 2 && (text[0] == '\'' || text[0] == '"') && text[len - 1] == text[0])
+    {
+        text[len - 1] = 0;
+        text++;
+    }
+
+    alias = malloc(sizeof(struct shellAlias));
+    alias->text = strdup(text);
+    alias->body = parseLine(shell, text, false);
+    freeAlias(shell, hashInsert(&shell->aliases, definition, alias));
+    free(definition);
+}
+
+/*
+*   Runs the built in command unalias, which removes each alias named.
+*/
+void runUnaliasCommand(struct shellContext* shell, struct commandElements* curCommand)
+{
+    int i;
+
+    for(i = 1; i < curCommand->numArguments; i++)
+    {
+        freeAlias(shell, hashRemove(&shell->aliases, curCommand->commands[i]));
+    }
+}
+
+/*
+*   Runs the built in command exit [--wait] [-t GRACE]. Background
+*   jobs are shut down before the shell exits: with --wait they are
+*   first left to finish, then any left get SIGTERM and GRACE, 2s by
+*   default, before SIGKILL. Returns false on bad options, then the
+*   shell keeps running.
+*/
+bool runExit(struct shellContext* shell, struct commandElements* curCommand)
+{
+    long long grace = DEFAULT_SHUTDOWN_GRACE;
+    bool drain = false;
+    int i;
+
+    for(i = 1; i < curCommand->numArguments && grace != -1; i++)
+    {
+        if(strcmp(curCommand->commands[i], "--wait") == 0)
+        {
+            drain = true;
+        }
+        else if(strcmp(curCommand->commands[i], "-t") == 0 && i + 1 < curCommand->numArguments)
+        {
+            grace = parseDuration(curCommand->commands[++i]);
+        }
+        else
+        {
+            grace = -1;
+        }
+    }
+
+    if(grace == -1)
+    {
+        fprintf(stderr, "usage: exit [--wait] [-t DURATION]\n");
+        fflush(stderr);
+        strcpy(shell->exitStatus, "exit value 2");
+        return false;
+    }
+
+    shutdownJobs(shell, drain, grace);
+    return true;
+}
+
+/*
+*   Runs the built in command timeout [-s SIGNAL] [-k GRACE] DURATION
+*   COMMAND [ARG]... COMMAND is run in a foreground or background
+*   child and sent SIGNAL, SIGTERM by default, if it is still running
+*   after DURATION, then SIGKILL if it is still running GRACE later,
+*   5s by default. Durations are seconds with an optional suffix s, m,
+*   h or d, and 0 turns the timeout or SIGKILL off. status reports
+*   "terminated by timeout" for a command it stopped.
+*/
+void runTimeoutCommand(struct shellContext* shell, struct commandElements* curCommand)
+{
+    long long duration = -1;
+    long long grace = DEFAULT_TIMEOUT_GRACE;
+    int signo = SIGTERM;
+    int i = 1;
+
+    while(i < curCommand->numArguments - 1 && signo != -1 && grace != -1)
+    {
+        if(strcmp(curCommand->commands[i], "-s") == 0)
+        {
+            signo = parseSignal(curCommand->commands[i + 1]);
+        }
+        else if(strcmp(curCommand->commands[i], "-k") == 0)
+        {
+            grace = parseDuration(curCommand->commands[i + 1]);
+        }
+        else
+        {
+            break;
+        }
+        i += 2;
+    }
+    if(i < curCommand->numArguments)
+    {
+        duration = parseDuration(curCommand->commands[i]);
+    }
+
+    if(signo == -1 || grace == -1 || duration == -1 || i + 1 >= curCommand->numArguments)
+    {
+        fprintf(stderr, "usage: timeout [-s SIGNAL] [-k DURATION] DURATION COMMAND [ARG]...\n");
+        fflush(stderr);
+        strcpy(shell->exitStatus, "exit value 125");
+        return;
+    }
+
+    // Run the rest of the words as the command, with its NULL
+    i++;
+    memmove(curCommand->commands, curCommand->commands + i,
+        (curCommand->numArguments - i + 1) * sizeof(char*));
+    curCommand->numArguments -= i;
+
+    curCommand->timeout = duration;
+    curCommand->timeoutSignal = signo;
+    curCommand->timeoutGrace = grace;
+    runOtherCommands(shell, curCommand);
+    curCommand->timeout = 0;
+}
+
+/*
+*   Run foreground parent process.
+*/
+void runFGParent(struct shellContext* shell, pid_t spawnpid, struct commandElements* curCommand)
+{
+    int childExitStatus;
+    char status[256];
+    
+    // Change SIGINT to ignore
+    SIGINT_action.sa_handler = SIG_IGN;
+    sigaction(SIGINT, &SIGINT_action, NULL);
+
+    // Deadlines of timeouts fire and job output is drained while
+    // waiting
+    postBoardForeground(shell, spawnpid, curCommand->commands, curCommand->numArguments);
+    spawnpid = waitForChild(shell, spawnpid, &childExitStatus);
+    postBoardForeground(shell, -1, NULL, 0);
+
+    // Get exit status, a child stopped by its timeout is reported as
+    // such whatever signal ended it
+    if(removeDeadline(shell, spawnpid))
+    {
+        strcpy(shell->exitStatus, "terminated by timeout");
+    }
+    else if(WIFEXITED(childExitStatus))
+    {
+        SIGINT_action.sa_handler = SIG_IGN;
+        sigaction(SIGINT, &SIGINT_action, NULL);
+        
+        // Change exit status to string
+        sprintf(status, "%d", WEXITSTATUS(childExitStatus));
+
+        // Then concatenate exit status and store in curCommand struct
+        memset(shell->exitStatus,0,strlen(shell->exitStatus));
+        strcpy(shell->exitStatus, "exit value ");
+        strcat(shell->exitStatus, status);
+    }
+    else
+    {
+        SIGINT_action.sa_handler = SIG_IGN;
+        sigaction(SIGINT, &SIGINT_action, NULL);
+
+        // Change termination signal to string
+        sprintf(status, "%d", WTERMSIG(childExitStatus));
+
+        // Then concatenate exit status and store in curCommand struct
+        memset(shell->exitStatus, 0, strlen(shell->exitStatus));
+        strcpy(shell->exitStatus, "terminated by signal ");
+        strcat(shell->exitStatus, status);
+
+        // If terminated with 2, print to screen
+        if(WTERMSIG(childExitStatus) == 2)
+        {
+            printf("%s\n", shell->exitStatus);
+            fflush(stdout);
+        }
+    }
+}
+
+/*
+*   Exec curCommand in its child, with the shell's envp as it is. If
+*   exec fails the error is printed, errno is written to the exec
+*   status pipe if there is one, and the child exits with 127 if the
+*   command was not found or 126 if it could not be run, so it never
+*   goes on as a copy of the shell.
+*/
+void execCommand(struct shellContext* shell, struct commandElements* curCommand)
+{
+    int error;
+
+    overlayEnvironment(shell, curCommand);
+    execvpe(curCommand->commands[0], curCommand->commands, shell->environment.envp);
+
+    error = errno;
+    fprintf(stderr, "%s: %s\n", curCommand->commands[0], strerror(error));
+    fflush(stderr);
+    if(curCommand->execStatusFD != -1)
+    {
+        write(curCommand->execStatusFD, &error, sizeof(error));
+    }
+    _exit(error == ENOENT ? 127 : 126);
+}
+
+/*
+*   Run foreground child process
+*/
+void runFGChild(struct shellContext* shell, struct commandElements* curCommand)
+{
+    // Change SIGINT to default
+    SIGINT_action.sa_handler = SIG_DFL;
+    sigaction(SIGINT, &SIGINT_action, NULL);
+
+    // Change SIGTSTP to ignore
+    SIGTSTP_action.sa_handler = SIG_IGN;
+    sigaction(SIGTSTP, &SIGTSTP_action, NULL); 
+
+    // Redirections were planned by the parent
+    applyRedirections(curCommand);
+    waitForBoardForeground(shell, getpid());
+
+    // Child will use a function from the exec() family of functions
+    // to run the command
+    execCommand(shell, curCommand);
+}
+
+/*
+*   Fork a foreground child that execs curCommand, with a CLOEXEC
+*   pipe that tells the parent if the exec worked. One read gets end
+*   of file once exec closed the pipe, or the errno of a failed exec,
+*   in which case the child is reaped here and the status is exit
+*   value 127 or 126. Returns the pid of the running child, or -1.
+*/
+pid_t startFGProcess(struct shellContext* shell, struct commandElements* curCommand)
+{
+    int statusPipe[2] = {-1, -1};
+    pid_t spawnpid;
+    ssize_t n;
+    int error;
+
+    pipe2(statusPipe, O_CLOEXEC);
+    curCommand->execStatusFD = statusPipe[1];
+
+    fflush(stdout);
+    spawnpid = fork();
+    switch(spawnpid)
+    {
+        case -1:
+            perror("fork() failed!");
+            fflush(stderr);
+            break;
+        case 0:     // Child execution
+            close(statusPipe[0]);
+            runFGChild(shell, curCommand);
+            break;
+        default:    // Posted before the read below, which waits for exec
+            postBoardForeground(shell, spawnpid, curCommand->commands, curCommand->numArguments);
+            break;
+    }
+
+    curCommand->execStatusFD = -1;
+    if(statusPipe[1] != -1)
+    {
+        close(statusPipe[1]);
+    }
+    closeRedirections(curCommand);
+
+    if(spawnpid > 0 && statusPipe[0] != -1)
+    {
+        while((n = read(statusPipe[0], &error, sizeof(error))) == -1 && errno == EINTR)
+        {
+        }
+        if(n == sizeof(error))
+        {
+            waitpid(spawnpid, NULL, 0);
+            postBoardForeground(shell, -1, NULL, 0);
+            sprintf(shell->exitStatus, "exit value %d", error == ENOENT ? 127 : 126);
+            spawnpid = -1;
+        }
+    }
+    if(statusPipe[0] != -1)
+    {
+        close(statusPipe[0]);
+    }
+
+    return spawnpid;
+}
+
+/*
+*   Run all foreground processes, parent and children
+*/
+void runFGProcess(struct shellContext* shell, struct commandElements* curCommand)
+{
+    pid_t spawnpid = startFGProcess(shell, curCommand);
+
+    if(spawnpid == -1)
+    {
+        return;
+    }
+
+    if(curCommand->timeout > 0)
+    {
+        addDeadline(shell, spawnpid, curCommand->timeout, curCommand->timeoutSignal,
+            curCommand->timeoutGrace);
+    }
+    runFGParent(shell, spawnpid, curCommand);
+}
+
+/*
+*   Run background parent process
+*/
+void runBGParent(pid_t spawnpid, struct commandElements* curCommand)
+{
+    printf("background pid is %d\n", spawnpid);
+    fflush(stdout);
+
+    // Run in the background and do not wait for child process to
+    // finish, it is reaped by checkBGProcesses
+}
+
+/*
+*   Run background child process
+*/
+void runBGChild(struct shellContext* shell, struct commandElements* curCommand)
+{
+    // Job is its own process group, so it can be stopped as a whole
+    setpgid(0, 0);
+
+    // Change SIGTSTP to ignore
+    SIGTSTP_action.sa_handler = SIG_IGN;
+    sigaction(SIGTSTP, &SIGTSTP_action, NULL); 
+
+    // Redirections were planned by the parent, with /dev/null for
+    // stdin and stdout if they are not redirected
+    applyRedirections(curCommand);
+
+    // Child will use a function from the exec() family of functions
+    // to run the command, a failure is reported when the job is
+    // reaped
+    execCommand(shell, curCommand);
+}
+
+/*
+*   Commands ran as background processes. Shell will not wait for
+*   these commands to complete. Parent must return command line
+*   access and control to the user immediately after forking off the
+*   child. The shell will print the process id of a background
+*   process when it begins. When a background process terminates, a
+*   message showing the process id and exit status will be printed.
+*   This message must be printed just before the prompt for a new
+*   command is displayed. If the user doesn't redirect the standard
+*   input for a background command, then standard input should be
+*   redirected to /dev/null. If the user doesn't redirect the
+*   standard output for a background command, then standard output
+*   should be redirected to /dev/null. Returns the pid of the job, or
+*   -1 if it could not be forked.
+*/
+pid_t runBGProcess(struct shellContext* shell, struct commandElements* curCommand)
+{
+    pid_t spawnpid = -5;
+
+    // Fork background child
+    spawnpid = fork();
+
+    // Add child to running list, in its own process group. Both
+    // sides set the group so it is set before either goes on.
+    if(spawnpid > 0)
+    {
+        setpgid(spawnpid, spawnpid);
+        addToPIDList(shell, spawnpid);
+    }
+    
+    switch(spawnpid)
+    {
+        case -1:
+            perror("fork() failed!");
+            fflush(stderr);
+            break;
+        case 0:     // Child execution
+            runBGChild(shell, curCommand);
+            break;
+        default:    // Parent execution
+            if(curCommand->timeout > 0)
+            {
+                addDeadline(shell, spawnpid, curCommand->timeout, curCommand->timeoutSignal,
+                    curCommand->timeoutGrace);
+            }
+            if(curCommand->logFD != -1)
+            {
+                addJobLog(shell, spawnpid, curCommand->logFD);
+                curCommand->logFD = -1;
+            }
+            postBoardJob(shell, spawnpid, curCommand->commands, curCommand->numArguments);
+            closeRedirections(curCommand);
+            runBGParent(spawnpid, curCommand);
+            break;
+    }
+
+    return spawnpid;
+}
+
+/*
+*   Returns true if curCommand can be exec'd in place of the shell: it
+*   runs in the foreground without a timeout, there are no jobs left
+*   that the shell would have to reap, report or shut down, and no
+*   status board that would show the shell idle and keep its file.
+*/
+bool canTailExec(struct shellContext* shell, struct commandElements* curCommand)
+{
+    int i;
+
+    if(!curCommand->fg || curCommand->bg || curCommand->timeout > 0 || shell->serving ||
+        shell->board != NULL)
+    {
+        return false;
+    }
+    for(i = 0; i < MAX_COMMAND_LINE_ARGUMENTS; i++)
+    {
+        if(shell->processIDs[i] != -1)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+*   Mark the last command of node list, the last line of a script, to
+*   be exec'd in place of the shell if it is run as a foreground
+*   command when nothing else needs the shell. Only a plain command at
+*   the top of the list is marked, not one in a loop, group or job.
+*/
+void markTailCommand(struct shellContext* shell, struct commandNode* node)
+{
+    shell->tailCommand = NULL;
+    while(node != NULL && node->next != NULL)
+    {
+        node = node->next;
+    }
+    if(node != NULL && node->type == NODE_COMMAND)
+    {
+        shell->tailCommand = node->command;
+    }
+}
+
+/*
+*   Runs the built in command exec [COMMAND [ARG]...]. COMMAND replaces
+*   the shell, with its redirections and NAME=value words applied, and
+*   if it can not be run the shell exits with 127 or 126. Without a
+*   COMMAND the redirections are applied to the shell itself and kept.
+*/
+void runExecCommand(struct shellContext* shell, struct commandElements* curCommand)
+{
+    int saved[MAX_PLANNED_OPS];
+    int i;
+
+    if(!planRedirections(shell, curCommand))
+    {
+        strcpy(shell->exitStatus, "exit value 1");
+        return;
+    }
+
+    if(curCommand->numArguments == 1)
+    {
+        strcpy(shell->exitStatus, "exit value 0");
+        if(!applyShellRedirections(curCommand, saved))
+        {
+            strcpy(shell->exitStatus, "exit value 1");
+        }
+        else
+        {
+            for(i = 0; i < curCommand->numPlanned; i++)
+            {
+                if(saved[i] != -1)
+                {
+                    close(saved[i]);
+                }
+            }
+        }
+        closeRedirections(curCommand);
+        return;
+    }
+
+    // Run the words after exec as the command, with its NULL. The
+    // shell ends either way, so its board goes first
+    memmove(curCommand->commands, curCommand->commands + 1,
+        curCommand->numArguments * sizeof(char*));
+    curCommand->numArguments--;
+    closeStatusBoard(shell);
+    fflush(stdout);
+    runFGChild(shell, curCommand);
+}
+
+/*
+*   Run any other commands using fork(), exec(), and waitpid()
+*   Foreground commands: any command without an & at the end. Shell
+*   must wait for the completion of the command before prompting for
+*   the next command. Do not return command line access until child
+*   terminates.
+*/
+void runOtherCommands(struct shellContext* shell, struct commandElements* curCommand)
+{
+    // Open files for redirection before forking, a file that can not
+    // be opened fails the command like a child exiting with 1
+    if(!planRedirections(shell, curCommand))
+    {
+        if(curCommand->fg)
+        {
+            strcpy(shell->exitStatus, "exit value 1");
+        }
+        return;
+    }
+
+    // First, determine if foreground/background command
+    // If foreground
+    if(curCommand == shell->tailCommand && canTailExec(shell, curCommand))
+    {
+        // Nothing is left for the shell to do after the last command
+        fflush(stdout);
+        runFGChild(shell, curCommand);
+    }
+    else if(curCommand->fg == true)
+    {
+        runFGProcess(shell, curCommand);
+    }
+    else
+    {
+        runBGProcess(shell, curCommand);
+    }
+}
+
+/*
+*   Returns index of command in builtInCommands, or -1 if it is not a
+*   built in command.
+*/
+int findBuiltIn(const char* command)
+{
+    int i;
+
+    for(i = 0; i < NUM_BUILT_INS; i++)
+    {
+        if(strcmp(command, builtInCommands[i]) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/*
+*   Run a built in that reads and writes files, cat or tee, in the
+*   shell with the redirections of curCommand applied around it like
+*   a { list; } group. Ctrl-C stops it and the status is that of a
+*   child killed by SIGINT. In the background it has no shell to run
+*   in, and with an option it does not take it can not do what is
+*   asked, so the command of that name is run instead.
+*/
+void runRedirectedBuiltIn(struct shellContext* shell, struct commandElements* curCommand,
+    void (*runBuiltIn)(struct shellContext*, struct commandElements*))
+{
+    struct sigaction ignoreAction = {0};
+    struct sigaction pipeAction;
+    struct sigaction interruptAction;
+    int saved[MAX_PLANNED_OPS];
+    bool interrupted;
+
+    if(curCommand->bg || hasCopyOptions(curCommand))
+    {
+        runOtherCommands(shell, curCommand);
+    }
+    else if(!planRedirections(shell, curCommand))
+    {
+        strcpy(shell->exitStatus, "exit value 1");
+    }
+    else if(applyShellRedirections(curCommand, saved))
+    {
+        // A reader that goes away is an EPIPE error, and not a signal
+        // that kills the shell
+        ignoreAction.sa_handler = SIG_IGN;
+        sigaction(SIGPIPE, &ignoreAction, &pipeAction);
+        catchCopySIGINT(&interruptAction);
+        runBuiltIn(shell, curCommand);
+        interrupted = releaseCopySIGINT(&interruptAction);
+        sigaction(SIGPIPE, &pipeAction, NULL);
+        restoreShellRedirections(curCommand, saved, curCommand->numPlanned);
+        closeRedirections(curCommand);
+
+        // Reported like a foreground child killed by SIGINT
+        if(interrupted)
+        {
+            strcpy(shell->exitStatus, "terminated by signal 2");
+            printf("%s\n", shell->exitStatus);
+            fflush(stdout);
+        }
+    }
+    else
+    {
+        closeRedirections(curCommand);
+        strcpy(shell->exitStatus, "exit value 1");
+    }
+}
+
+/*
+*   Runs all commands whether they are built in or not.
+*/
+bool runCommands(struct shellContext* shell, struct commandElements* curCommand)
+{
+    bool isExiting = false;
+    int builtInNum = -1;
+
+    // Check for built in commands
+    builtInNum = findBuiltIn(curCommand->commands[0]) + 1;
+
+    // Determine which command to run
+    switch(builtInNum)
+    {
+        case 1: // exit command
+            curCommand->fg = true;
+            curCommand->bg = false;
+            isExiting = runExit(shell, curCommand);
+            return isExiting;   // return immediately to exit
+            break;
+        case 2: // cd command
+            curCommand->fg = true;
+            curCommand->bg = false;
+            // If no argument after cd
+            strcpy(shell->exitStatus, runCdCommand(shell, curCommand) ? "exit value 0" : "exit value 1");
+            // i = runCdCommand(curCommand, i); // Change index if needed
+            break;
+        case 3: // status command
+            curCommand->fg = true;
+            curCommand->bg = false;
+            // Prints out either the exit status or the
+            // terminating signal of the last foreground process
+            // ran by the shell
+            printf("%s\n", shell->exitStatus);
+            fflush(stdout);
+            break;
+        case 4: // alias command
+            runAliasCommand(shell, curCommand);
+            break;
+        case 5: // unalias command
+            runUnaliasCommand(shell, curCommand);
+            break;
+        case 6: // timeout command
+            runTimeoutCommand(shell, curCommand);
+            break;
+        case 7: // joblog command
+            runJobLogCommand(shell, curCommand);
+            break;
+        case 8: // export command
+            runExportCommand(shell, curCommand);
+            break;
+        case 9: // unset command
+            runUnsetCommand(shell, curCommand);
+            break;
+        case 10: // onchange command
+            runOnchangeCommand(shell, curCommand);
+            break;
+        case 11: // cat command
+        case 12: // tee command
+            runRedirectedBuiltIn(shell, curCommand, builtInNum == 11 ? runCatCommand : runTeeCommand);
+            break;
+        case 13: // exec command
+            runExecCommand(shell, curCommand);
+            break;
+        case 14: // cache command
+            runCacheCommand(shell, curCommand);
+            break;
+        case 15: // let command
+            runLetCommand(shell, curCommand);
+            break;
+        default: // none built in
+            runOtherCommands(shell, curCommand);
+            break;
+    }
+
+    return isExiting;
+}
+
+/*
+*   Run a command of only NAME=value words by setting the shell
+*   variables, in order. Values are expanded but not split, and the
+*   status is 1 if an expansion fails.
+*/
+void runAssignment(struct shellContext* shell, struct commandElements* curCommand)
+{
+    char* value;
+    char* word;
+    char* equals;
+    char* name;
+    int i;
+
+    for(i = 0; i < curCommand->numAssignments; i++)
+    {
+        word = curCommand->assignments[i];
+        equals = strchr(word, '=');
+        name = strndup(word, equals - word);
+
+        releaseExpansion(curCommand);
+        shell->expansionFailed = false;
+        value = expandJoined(shell, equals + 1, &curCommand->expansion);
+        if(shell->expansionFailed)
+        {
+            // The assignments after a failed one are not made
+            strcpy(shell->exitStatus, "exit value 1");
+            releaseExpansion(curCommand);
+            free(name);
+            break;
+        }
+        setVariable(shell, name, value);
+        releaseExpansion(curCommand);
+        free(name);
+    }
+}
+
+/*
+*   Set the NAME=value words before a built in, function or alias as
+*   shell variables while it runs. The values they replace are saved
+*   in saved, NULL for a variable that was not set.
+*/
+void setTemporaryVariables(struct shellContext* shell, struct commandElements* curCommand, char** saved)
+{
+    const char* value;
+    char* equals;
+    char* name;
+    int i;
+
+    for(i = 0; i < curCommand->numAssignments; i++)
+    {
+        equals = strchr(curCommand->overlay[i], '=');
+        name = strndup(curCommand->overlay[i], equals - curCommand->overlay[i]);
+        value = getVariable(shell, name);
+        saved[i] = value != NULL ? strdup(value) : NULL;
+        setVariable(shell, name, equals + 1);
+        free(name);
+    }
+}
+
+/*
+*   Put back the variables setTemporaryVariables set, last first.
+*/
+void restoreTemporaryVariables(struct shellContext* shell, struct commandElements* curCommand, char** saved)
+{
+    char* equals;
+    char* name;
+    int i;
+
+    for(i = curCommand->numAssignments - 1; i >= 0; i--)
+    {
+        equals = strchr(curCommand->overlay[i], '=');
+        name = strndup(curCommand->overlay[i], equals - curCommand->overlay[i]);
+        if(saved[i] != NULL)
+        {
+            setVariable(shell, name, saved[i]);
+            free(saved[i]);
+        }
+        else
+        {
+            free(hashRemove(&shell->variables, name));
+        }
+        free(name);
+    }
+}
+
+/*
+*   Returns true if the last foreground command exited with value 0.
+*/
+bool lastCommandSucceeded(struct shellContext* shell)
+{
+    return strcmp(shell->exitStatus, "exit value 0") == 0;
+}
+
+/*
+*   Returns the last foreground status as an exit code: the exit
+*   value, 128 plus the signal, or 124 after a timeout.
+*/
+int exitStatusCode(struct shellContext* shell)
+{
+    int code;
+
+    if(sscanf(shell->exitStatus, "exit value %d", &code) == 1)
+    {
+        return code;
+    }
+    if(sscanf(shell->exitStatus, "terminated by signal %d", &code) == 1)
+    {
+        return 128 + code;
+    }
+    return 124;
+}
+
+/*
+*   Run the && || list of node in a background child. The child runs
+*   the commands in the foreground and exits with the status of the
+*   last one. Its stdin and stdout are planned like those of a
+*   background command, and it is a job like one.
+*/
+void runBackgroundList(struct shellContext* shell, struct commandNode* node)
+{
+    struct commandElements* curCommand = node->command;
+    pid_t spawnpid;
+
+    if(!planRedirections(shell, curCommand))
+    {
+        return;
+    }
+
+    spawnpid = fork();
+    switch(spawnpid)
+    {
+        case -1:
+            perror("fork() failed!");
+            fflush(stderr);
+            closeRedirections(curCommand);
+            break;
+        case 0:     // Child execution
+            setpgid(0, 0);
+            SIGTSTP_action.sa_handler = SIG_IGN;
+            sigaction(SIGTSTP, &SIGTSTP_action, NULL);
+            applyRedirections(curCommand);
+            resetChildShell(shell);
+
+            runNodeList(shell, node->body);
+            fflush(stdout);
+            _exit(exitStatusCode(shell));
+        default:    // Parent execution
+            setpgid(spawnpid, spawnpid);
+            addToPIDList(shell, spawnpid);
+            if(node->body->type == NODE_COMMAND)
+            {
+                postBoardJob(shell, spawnpid, node->body->command->words, node->body->command->numWords);
+            }
+            if(curCommand->logFD != -1)
+            {
+                addJobLog(shell, spawnpid, curCommand->logFD);
+                curCommand->logFD = -1;
+            }
+            closeRedirections(curCommand);
+            runBGParent(spawnpid, curCommand);
+            break;
+    }
+}
+
+/*
+*   Run the list of a ( list ) subshell node in one foreground child,
+*   which exits with the status of the list. The redirections of the
+*   node are planned by the caller.
+*/
+void runSubshell(struct shellContext* shell, struct commandNode* node)
+{
+    struct commandElements* curCommand = node->command;
+    pid_t spawnpid;
+
+    fflush(stdout);
+    spawnpid = fork();
+    switch(spawnpid)
+    {
+        case -1:
+            perror("fork() failed!");
+            fflush(stderr);
+            closeRedirections(curCommand);
+            break;
+        case 0:     // Child execution
+            // Change SIGTSTP to ignore, as in any foreground child
+            SIGTSTP_action.sa_handler = SIG_IGN;
+            sigaction(SIGTSTP, &SIGTSTP_action, NULL);
+            applyRedirections(curCommand);
+            resetChildShell(shell);
+
+            runNodeList(shell, node->body);
+            fflush(stdout);
+            _exit(exitStatusCode(shell));
+        default:    // Parent execution
+            closeRedirections(curCommand);
+            runFGParent(shell, spawnpid, curCommand);
+            break;
+    }
+}
+
+/*
+*   Run a { list; } group or ( list ) subshell node. Its redirections
+*   are opened once for the whole list. A group runs in this shell,
+*   with the fds it redirects saved and put back after it. A subshell,
+*   or any of them run in the background, is one child and one job.
+*   Returns true if the shell is exiting.
+*/
+bool runGroup(struct shellContext* shell, struct commandNode* node)
+{
+    struct commandElements* curCommand = node->command;
+    int saved[MAX_PLANNED_OPS];
+    bool isExiting = false;
+
+    expandCommand(shell, curCommand);
+    if(curCommand->bg)
+    {
+        runBackgroundList(shell, node);
+    }
+    else if(!planRedirections(shell, curCommand))
+    {
+        strcpy(shell->exitStatus, "exit value 1");
+    }
+    else if(node->type == NODE_SUBSHELL)
+    {
+        runSubshell(shell, node);
+    }
+    else if(applyShellRedirections(curCommand, saved))
+    {
+        isExiting = runNodeList(shell, node->body);
+        restoreShellRedirections(curCommand, saved, curCommand->numPlanned);
+        closeRedirections(curCommand);
+    }
+    else
+    {
+        closeRedirections(curCommand);
+        strcpy(shell->exitStatus, "exit value 1");
+    }
+    releaseExpansion(curCommand);
+
+    return isExiting;
+}
+
+/*
+*   Returns true if the last foreground command was killed by SIGINT,
+*   which stops any loop it is in.
+*/
+bool lastCommandInterrupted(struct shellContext* shell)
+{
+    return strcmp(shell->exitStatus, "terminated by signal 2") == 0;
+}
+
+/*
+*   Returns true if command is run by the shell itself, a built in,
+*   function or alias, and not by exec.
+*/
+bool isShellCommand(struct shellContext* shell, const char* command)
+{
+    return findBuiltIn(command) != -1 || hashLookup(&shell->functions, command) != NULL ||
+        hashLookup(&shell->aliases, command) != NULL;
+}
+
+/*
+*   If the first word of curCommand is an alias for a single command,
+*   replace it with the words of that command, keeping the other
+*   arguments. The alias command's redirections are used if
+*   curCommand has none. Returns the alias if it is for anything
+*   else, which is then run in place of curCommand, otherwise NULL.
+*/
+struct shellAlias* applyAlias(struct shellContext* shell, struct commandElements* curCommand)
+{
+    struct shellAlias* alias = hashLookup(&shell->aliases, curCommand->commands[0]);
+    struct commandElements* aliasCommand;
+    struct wordList* expansion = &curCommand->expansion;
+    char* arguments[MAX_COMMAND_LINE_ARGUMENTS];
+    int start = expansion->numWords;
+    int numArguments = 0;
+    int i;
+
+    if(alias == NULL || alias->body == NULL)
+    {
+        return alias;
+    }
+    if(alias->body->type != NODE_COMMAND || alias->body->next != NULL ||
+        alias->body->command->isAssignment)
+    {
+        return alias;
+    }
+
+    aliasCommand = alias->body->command;
+    for(i = 0; i < aliasCommand->numWords; i++)
+    {
+        expandWord(shell, aliasCommand->words[i], expansion, true);
+    }
+    for(i = start; i < expansion->numWords && numArguments < MAX_COMMAND_LINE_ARGUMENTS - 1; i++)
+    {
+        arguments[numArguments++] = expansion->words[i];
+    }
+    for(i = 1; i < curCommand->numArguments && numArguments < MAX_COMMAND_LINE_ARGUMENTS - 1; i++)
+    {
+        arguments[numArguments++] = curCommand->commands[i];
+    }
+    memcpy(curCommand->commands, arguments, numArguments * sizeof(char*));
+    curCommand->commands[numArguments] = NULL;
+    curCommand->numArguments = numArguments;
+
+    curCommand->redirectSource = aliasCommand;
+
+    return NULL;
+}
+
+/*
+*   Call a shell function. The arguments of curCommand become $1 and
+*   on while body runs in this process, no child is forked. Returns
+*   true if the shell is exiting.
+*/
+bool callFunction(struct shellContext* shell, struct commandNode* body, struct commandElements* curCommand)
+{
+    char** savedArgs = shell->positionalArgs;
+    int savedNumArgs = shell->numPositionalArgs;
+    bool isExiting;
+    int i;
+
+    shell->numPositionalArgs = curCommand->numArguments - 1;
+    shell->positionalArgs = malloc((shell->numPositionalArgs + 1) * sizeof(char*));
+    for(i = 0; i < shell->numPositionalArgs; i++)
+    {
+        shell->positionalArgs[i] = strdup(curCommand->commands[i + 1]);
+    }
+
+    isExiting = runNodeList(shell, body);
+
+    for(i = 0; i < shell->numPositionalArgs; i++)
+    {
+        free(shell->positionalArgs[i]);
+    }
+    free(shell->positionalArgs);
+    shell->positionalArgs = savedArgs;
+    shell->numPositionalArgs = savedNumArgs;
+
+    return isExiting;
+}
+
+/*
+*   Run one node. Commands are expanded on each run from the words
+*   parsed once. Returns true if the shell is exiting.
+*/
+bool runNode(struct shellContext* shell, struct commandNode* node)
+{
+    struct commandElements* curCommand = node->command;
+    struct wordList loopWords = {0};
+    struct shellAlias* alias;
+    struct commandNode* function;
+    char* saved[MAX_ASSIGNMENTS];
+    bool isTemporary;
+    bool isExiting = false;
+    int i;
+
+    switch(node->type)
+    {
+        case NODE_COMMAND:
+            if(curCommand->isAssignment)
+            {
+                runAssignment(shell, curCommand);
+                break;
+            }
+            shell->expansionFailed = false;
+            expandCommand(shell, curCommand);
+            if(shell->expansionFailed)
+            {
+                // A command with an arithmetic error is not run
+                strcpy(shell->exitStatus, "exit value 1");
+                releaseExpansion(curCommand);
+                break;
+            }
+            if(curCommand->numArguments == 0)
+            {
+                releaseExpansion(curCommand);
+                break;
+            }
+
+            // NAME=value words go in the environment of a child, and
+            // are shell variables while a shell command runs
+            isTemporary = curCommand->numAssignments > 0 && isShellCommand(shell, curCommand->commands[0]);
+            if(isTemporary)
+            {
+                setTemporaryVariables(shell, curCommand, saved);
+            }
+
+            // Aliases and functions come before built ins and $PATH
+            shell->commandDepth++;
+            alias = applyAlias(shell, curCommand);
+            if(alias != NULL)
+            {
+                isExiting = runNodeList(shell, alias->body);
+            }
+            else if((function = hashLookup(&shell->functions, curCommand->commands[0])) != NULL)
+            {
+                isExiting = callFunction(shell, function, curCommand);
+            }
+            else
+            {
+                isExiting = runCommands(shell, curCommand);
+            }
+            if(--shell->commandDepth == 0)
+            {
+                freeNodeList(shell->retiredBodies);
+                shell->retiredBodies = NULL;
+            }
+            if(isTemporary)
+            {
+                restoreTemporaryVariables(shell, curCommand, saved);
+            }
+            releaseExpansion(curCommand);
+            break;
+        case NODE_FUNCTION:
+            // Function table takes the parsed body
+            if(node->body != NULL)
+            {
+                function = hashInsert(&shell->functions, node->variable, node->body);
+                retireNodeList(shell, function);
+                node->body = NULL;
+            }
+            break;
+        case NODE_FOR:
+            for(i = 0; i < node->numLoopWords; i++)
+            {
+                expandWord(shell, node->loopWords[i], &loopWords, true);
+            }
+            // Pipes of process substitutions are kept by the commands
+            // of the body that name them
+            for(i = 0; i < loopWords.numFDs; i++)
+            {
+                fcntl(loopWords.fds[i], F_SETFD, 0);
+            }
+            for(i = 0; i < loopWords.numWords && !isExiting; i++)
+            {
+                setVariable(shell, node->variable, loopWords.words[i]);
+                isExiting = runNodeList(shell, node->body);
+                if(lastCommandInterrupted(shell))
+                {
+                    break;
+                }
+            }
+            clearWordList(&loopWords);
+            free(loopWords.words);
+            free(loopWords.buffers);
+            free(loopWords.fds);
+            break;
+        case NODE_BACKGROUND:
+            runBackgroundList(shell, node);
+            break;
+        case NODE_GROUP:
+        case NODE_SUBSHELL:
+            isExiting = runGroup(shell, node);
+            break;
+        case NODE_WHILE:
+            while(!isExiting)
+            {
+                isExiting = runNodeList(shell, node->condition);
+                if(isExiting || !lastCommandSucceeded(shell))
+                {
+                    break;
+                }
+                isExiting = runNodeList(shell, node->body);
+                if(lastCommandInterrupted(shell))
+                {
+                    break;
+                }
+            }
+            break;
+    }
+
+    return isExiting;
+}
+
+/*
+*   Run a list of nodes in order. Returns true if the shell is
+*   exiting.
+*/
+bool runNodeList(struct shellContext* shell, struct commandNode* node)
+{
+    bool isExiting = false;
+
+    for(; node != NULL && !isExiting; node = node->next)
+    {
+        // After && or || a node runs only if the last command run
+        // succeeded or failed
+        if((node->connector == LIST_AND && !lastCommandSucceeded(shell)) ||
+            (node->connector == LIST_OR && lastCommandSucceeded(shell)))
+        {
+            continue;
+        }
+        isExiting = runNode(shell, node);
+    }
+
+    return isExiting;
+}
@@ -0,0 +1,170 @@
+/*
+*   String keyed hash table with chained buckets, used for shell
+*   variables, functions and aliases.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "smallsh.h"
+
+/*
+*   Hash a string key, djb2.
+*/
+unsigned long hashString(const char* key)
+{
+    unsigned long hash = 5381;
+
+    while(*key != 0)
+    {
+        hash = hash * 33 + (unsigned char)*key++;
+    }
+
+    return hash;
+}
+
+/*
+*   Returns value stored for key in table, or NULL if there is none.
+*/
+void* hashLookup(struct hashTable* table, const char* key)
+{
+    struct hashEntry* entry;
+
+    if(table->numBuckets == 0)
+    {
+        return NULL;
+    }
+
+    entry = table->buckets[hashString(key) & (table->numBuckets - 1)];
+    while(entry != NULL)
+    {
+        if(strcmp(entry->key, key) == 0)
+        {
+            return entry->value;
+        }
+        entry = entry->next;
+    }
+
+    return NULL;
+}
+
+/*
+*   Double the number of buckets of table and move the entries.
+*/
+void growHashTable(struct hashTable* table)
+{
+    int newNumBuckets = table->numBuckets ? table->numBuckets * 2 : 64;
+    struct hashEntry** newBuckets = calloc(newNumBuckets, sizeof(struct hashEntry*));
+    struct hashEntry* entry;
+    struct hashEntry* next;
+    unsigned long bucket;
+    int i;
+
+    for(i = 0; i < table->numBuckets; i++)
+    {
+        for(entry = table->buckets[i]; entry != NULL; entry = next)
+        {
+            next = entry->next;
+            bucket = hashString(entry->key) & (newNumBuckets - 1);
+            entry->next = newBuckets[bucket];
+            newBuckets[bucket] = entry;
+        }
+    }
+
+    free(table->buckets);
+    table->buckets = newBuckets;
+    table->numBuckets = newNumBuckets;
+}
+
+/*
+*   Store value for key in table. Returns the value it replaces, or
+*   NULL, so the caller can free it.
+*/
+void* hashInsert(struct hashTable* table, const char* key, void* value)
+{
+    struct hashEntry* entry;
+    unsigned long bucket;
+    void* oldValue;
+
+    if(table->numEntries >= table->numBuckets)
+    {
+        growHashTable(table);
+    }
+
+    bucket = hashString(key) & (table->numBuckets - 1);
+    for(entry = table->buckets[bucket]; entry != NULL; entry = entry->next)
+    {
+        if(strcmp(entry->key, key) == 0)
+        {
+            oldValue = entry->value;
+            entry->value = value;
+            return oldValue;
+        }
+    }
+
+    entry = malloc(sizeof(struct hashEntry));
+    entry->key = strdup(key);
+    entry->value = value;
+    entry->next = table->buckets[bucket];
+    table->buckets[bucket] = entry;
+    table->numEntries++;
+
+    return NULL;
+}
+
+/*
+*   Take key out of table. Returns its value, or NULL if there is
+*   none, so the caller can free it.
+*/
+void* hashRemove(struct hashTable* table, const char* key)
+{
+    struct hashEntry** link;
+    struct hashEntry* entry;
+    void* value;
+
+    if(table->numBuckets == 0)
+    {
+        return NULL;
+    }
+
+    link = &table->buckets[hashString(key) & (table->numBuckets - 1)];
+    for(entry = *link; entry != NULL; link = &entry->next, entry = *link)
+    {
+        if(strcmp(entry->key, key) == 0)
+        {
+            *link = entry->next;
+            value = entry->value;
+            free(entry->key);
+            free(entry);
+            table->numEntries--;
+            return value;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+*   Free the entries of table and their keys, leaving it empty. The
+*   values are the caller's to free first.
+*/
+void clearHashTable(struct hashTable* table)
+{
+    struct hashEntry* entry;
+    struct hashEntry* next;
+    int i;
+
+    for(i = 0; i < table->numBuckets; i++)
+    {
+        for(entry = table->buckets[i]; entry != NULL; entry = next)
+        {
+            next = entry->next;
+            free(entry->key);
+            free(entry);
+        }
+    }
+    free(table->buckets);
+    table->buckets = NULL;
+    table->numBuckets = 0;
+    table->numEntries = 0;
+}
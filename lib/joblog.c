@@ -0,0 +1,284 @@
+/*
+*   Captured output of background jobs. With joblog capture or tag,
+*   the stdout and stderr of a background job that are not redirected
+*   go to a pipe. The event loop drains the pipe into a ring buffer
+*   holding the last JOB_LOG_SIZE bytes, and in tag mode also prints
+*   each line tagged with the job's pid.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "smallsh.h"
+
+/*
+*   Returns the log of job pid, or NULL if there is none.
+*/
+struct jobLog* findJobLog(struct shellContext* shell, pid_t pid)
+{
+    int i;
+
+    for(i = 0; i < shell->jobLogs.numLogs; i++)
+    {
+        if(shell->jobLogs.logs[i].pid == pid)
+        {
+            return &shell->jobLogs.logs[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+*   Free the log at index of the list and close up the gap.
+*/
+void removeJobLog(struct jobLogList* list, int index)
+{
+    struct jobLog* log = &list->logs[index];
+
+    if(log->fd != -1)
+    {
+        close(log->fd);
+        list->numOpen--;
+    }
+    free(log->ring);
+    free(log->partial);
+
+    memmove(log, log + 1, (list->numLogs - index - 1) * sizeof(struct jobLog));
+    list->numLogs--;
+}
+
+/*
+*   Add a log for background job pid reading its output from fd. When
+*   there are MAX_JOB_LOGS, the oldest log of a finished job is
+*   dropped.
+*/
+void addJobLog(struct shellContext* shell, pid_t pid, int fd)
+{
+    struct jobLogList* list = &shell->jobLogs;
+    struct jobLog* log;
+    int i;
+
+    for(i = 0; i < list->numLogs && list->numLogs >= MAX_JOB_LOGS; i++)
+    {
+        if(list->logs[i].fd == -1)
+        {
+            removeJobLog(list, i--);
+        }
+    }
+
+    if(list->numLogs == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 8;
+        list->logs = realloc(list->logs, list->capacity * sizeof(struct jobLog));
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    log = &list->logs[list->numLogs++];
+    memset(log, 0, sizeof(struct jobLog));
+    log->pid = pid;
+    log->fd = fd;
+    log->ring = malloc(JOB_LOG_SIZE);
+    list->numOpen++;
+}
+
+/*
+*   Add len bytes of data to the ring buffer of log, overwriting the
+*   oldest bytes when it is full.
+*/
+void appendToRing(struct jobLog* log, const char* data, size_t len)
+{
+    size_t end;
+    size_t count;
+    size_t overflow;
+
+    if(len > JOB_LOG_SIZE)
+    {
+        log->dropped += len - JOB_LOG_SIZE;
+        data += len - JOB_LOG_SIZE;
+        len = JOB_LOG_SIZE;
+    }
+
+    overflow = log->length + len > JOB_LOG_SIZE ? log->length + len - JOB_LOG_SIZE : 0;
+    log->start = (log->start + overflow) % JOB_LOG_SIZE;
+    log->length -= overflow;
+    log->dropped += overflow;
+
+    // Copy in at most two parts, up to the end of the ring and from
+    // its start
+    end = (log->start + log->length) % JOB_LOG_SIZE;
+    count = len < JOB_LOG_SIZE - end ? len : JOB_LOG_SIZE - end;
+    memcpy(log->ring + end, data, count);
+    memcpy(log->ring, data + count, len - count);
+    log->length += len;
+}
+
+/*
+*   Print the finished lines of data tagged with the pid of log. The
+*   rest is kept until its line is finished, or printed if atEnd.
+*/
+void printTaggedLines(struct jobLog* log, const char* data, size_t len, bool atEnd)
+{
+    const char* newline;
+    size_t count;
+
+    if(log->partial == NULL)
+    {
+        log->partial = malloc(MAX_TAGGED_LINE);
+    }
+
+    while(len > 0)
+    {
+        newline = memchr(data, '\n', len);
+        count = newline != NULL ? (size_t)(newline - data) : len;
+        if(count > (size_t)(MAX_TAGGED_LINE - log->partialLen))
+        {
+            count = MAX_TAGGED_LINE - log->partialLen;
+            newline = NULL;
+        }
+        memcpy(log->partial + log->partialLen, data, count);
+        log->partialLen += count;
+        data += count + (newline != NULL);
+        len -= count + (newline != NULL);
+
+        if(newline != NULL || log->partialLen == MAX_TAGGED_LINE)
+        {
+            printf("[%d] %.*s\n", log->pid, log->partialLen, log->partial);
+            log->partialLen = 0;
+        }
+    }
+
+    if(atEnd && log->partialLen > 0)
+    {
+        printf("[%d] %.*s\n", log->pid, log->partialLen, log->partial);
+        log->partialLen = 0;
+    }
+    fflush(stdout);
+}
+
+/*
+*   Read what is in the pipe of log without blocking, into its ring
+*   and, in tag mode, to the terminal. The pipe is closed at its end.
+*   Returns true if tagged lines were printed.
+*/
+bool drainJobLog(struct shellContext* shell, struct jobLog* log)
+{
+    bool tagged = shell->jobOutputMode == JOB_OUTPUT_TAG;
+    bool printed = false;
+    char buffer[4096];
+    ssize_t n;
+
+    while(log->fd != -1)
+    {
+        n = read(log->fd, buffer, sizeof(buffer));
+        if(n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n == -1)
+        {
+            break;  // nothing more for now
+        }
+
+        if(n == 0)
+        {
+            close(log->fd);
+            log->fd = -1;
+            shell->jobLogs.numOpen--;
+        }
+        else
+        {
+            appendToRing(log, buffer, n);
+        }
+        if(tagged && (n > 0 || log->partialLen > 0))
+        {
+            printTaggedLines(log, buffer, n, n == 0);
+            printed = true;
+        }
+    }
+
+    return printed;
+}
+
+/*
+*   Drain the output of job pid, if it is captured.
+*/
+void drainJobOutput(struct shellContext* shell, pid_t pid)
+{
+    struct jobLog* log = findJobLog(shell, pid);
+
+    if(log != NULL)
+    {
+        drainJobLog(shell, log);
+    }
+}
+
+/*
+*   Runs the built in command joblog. joblog off, capture or tag sets
+*   what happens to the output of background jobs started after it:
+*   off sends it to /dev/null, capture keeps the last JOB_LOG_SIZE
+*   bytes of each job, and tag also prints each line as it comes,
+*   tagged with the job's pid. joblog PID prints what was kept of the
+*   job's output, and joblog alone lists the jobs with logs.
+*/
+void runJobLogCommand(struct shellContext* shell, struct commandElements* curCommand)
+{
+    const char* argument = curCommand->commands[1];
+    struct jobLog* log;
+    size_t count;
+    int i;
+
+    if(argument == NULL)
+    {
+        for(i = 0; i < shell->jobLogs.numLogs; i++)
+        {
+            log = &shell->jobLogs.logs[i];
+            drainJobLog(shell, log);
+            printf("%d %s %zu bytes\n", log->pid, log->fd != -1 ? "running" : "done",
+                log->length + log->dropped);
+        }
+        fflush(stdout);
+        return;
+    }
+
+    if(strcmp(argument, "off") == 0)
+    {
+        shell->jobOutputMode = JOB_OUTPUT_NULL;
+        return;
+    }
+    if(strcmp(argument, "capture") == 0)
+    {
+        shell->jobOutputMode = JOB_OUTPUT_CAPTURE;
+        return;
+    }
+    if(strcmp(argument, "tag") == 0)
+    {
+        shell->jobOutputMode = JOB_OUTPUT_TAG;
+        return;
+    }
+
+    log = findJobLog(shell, atoi(argument));
+    if(log == NULL)
+    {
+        fprintf(stderr, "joblog: no output kept for %s\n", argument);
+        fflush(stderr);
+        strcpy(shell->exitStatus, "exit value 1");
+        return;
+    }
+
+    drainJobLog(shell, log);
+    if(log->dropped > 0)
+    {
+        fprintf(stderr, "joblog: %zu earlier bytes dropped\n", log->dropped);
+        fflush(stderr);
+    }
+    count = log->length < JOB_LOG_SIZE - log->start ? log->length : JOB_LOG_SIZE - log->start;
+    fwrite(log->ring + log->start, 1, count, stdout);
+    fwrite(log->ring, 1, log->length - count, stdout);
+    fflush(stdout);
+}
@@ -0,0 +1,391 @@
+/*
+*   Job table of background processes, and shutting them down when
+*   the shell exits.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "smallsh.h"
+
+#define SHUTDOWN_POLL_MS 10     // check of jobs without a pidfd
+
+/*
+*   When this command is run, shell stops any other processes or jobs
+*   that shell has started before it terminates itself, with the
+*   default shutdown: no draining, DEFAULT_SHUTDOWN_GRACE to stop.
+*/
+void runExitCommand(struct shellContext* shell)
+{
+    shutdownJobs(shell, false, DEFAULT_SHUTDOWN_GRACE);
+    // Shell will be killed in main() by return EXIT_SUCCESS;
+}
+
+/*
+*   Reap job i of pids if it has finished, reporting it. A job with
+*   a pidfd is only waited for once the pidfd is readable, one without
+*   is checked with WNOHANG. Returns true if it was reaped.
+*/
+bool reapShutdownJob(struct shellContext* shell, pid_t* pids, struct pollfd* fds, bool* running,
+    int i)
+{
+    int childExitStatus;
+    pid_t result;
+
+    if(!running[i] || (fds[i].fd != -1 && fds[i].revents == 0))
+    {
+        return false;
+    }
+
+    result = waitpid(pids[i], &childExitStatus, fds[i].fd != -1 ? 0 : WNOHANG);
+    if(result == 0)
+    {
+        return false;
+    }
+    if(result == pids[i])
+    {
+        reportBGProcess(shell, pids[i], childExitStatus);
+    }
+    removeFromPIDList(shell, pids[i]);
+    if(fds[i].fd != -1)
+    {
+        close(fds[i].fd);
+        fds[i].fd = -1;
+    }
+    running[i] = false;
+
+    return result == pids[i];
+}
+
+/*
+*   Wait for the jobs in pids still running, reaping and reporting
+*   each as it finishes, until all are done or the deadline in
+*   monotonic ns passes. A deadline of -1 waits for all. Jobs with a
+*   pidfd in fds are polled, and if any has none the poll wakes every
+*   SHUTDOWN_POLL_MS to check it with waitpid. The pipes of captured
+*   job output are polled too and drained as they fill, so a job
+*   writing more than a pipe holds is not blocked for good. Returns
+*   the number reaped.
+*/
+int waitForJobs(struct shellContext* shell, pid_t* pids, struct pollfd* fds, bool* running,
+    int numJobs, long long deadline)
+{
+    struct pollfd* polled = malloc((numJobs + shell->jobLogs.numLogs) * sizeof(struct pollfd));
+    struct jobLog* log;
+    int numReaped = 0;
+    int numRunning;
+    bool hasUnwatched;
+    int timeoutMs;
+    int i;
+
+    while(true)
+    {
+        numRunning = 0;
+        hasUnwatched = false;
+        for(i = 0; i < numJobs; i++)
+        {
+            numRunning += running[i];
+            hasUnwatched = hasUnwatched || (running[i] && fds[i].fd == -1);
+        }
+        if(numRunning == 0)
+        {
+            break;
+        }
+
+        timeoutMs = -1;
+        if(deadline != -1)
+        {
+            timeoutMs = deadline <= monotonicNs() ? 0 :
+                (deadline - monotonicNs() + 999999) / 1000000;
+        }
+        if(hasUnwatched && (timeoutMs == -1 || timeoutMs > SHUTDOWN_POLL_MS))
+        {
+            timeoutMs = SHUTDOWN_POLL_MS;
+        }
+        for(i = 0; i < numJobs; i++)
+        {
+            polled[i] = fds[i];
+            polled[i].revents = 0;
+        }
+        for(i = 0; i < shell->jobLogs.numLogs; i++)
+        {
+            polled[numJobs + i].fd = shell->jobLogs.logs[i].fd;
+            polled[numJobs + i].events = POLLIN;
+            polled[numJobs + i].revents = 0;
+        }
+        poll(polled, numJobs + shell->jobLogs.numLogs, timeoutMs);
+
+        for(i = 0; i < shell->jobLogs.numLogs; i++)
+        {
+            log = &shell->jobLogs.logs[i];
+            if(polled[numJobs + i].revents != 0 && log->fd == polled[numJobs + i].fd)
+            {
+                drainJobLog(shell, log);
+            }
+        }
+        for(i = 0; i < numJobs; i++)
+        {
+            fds[i].revents = polled[i].revents;
+            numReaped += reapShutdownJob(shell, pids, fds, running, i);
+        }
+        if(deadline != -1 && deadline <= monotonicNs())
+        {
+            break;
+        }
+    }
+
+    free(polled);
+    return numReaped;
+}
+
+/*
+*   Send signo to the process group of each job still running, or to
+*   the job itself if it is not a group leader.
+*/
+void signalJobs(pid_t* pids, bool* running, int numJobs, int signo)
+{
+    int i;
+
+    for(i = 0; i < numJobs; i++)
+    {
+        if(running[i] && kill(-pids[i], signo) == -1)
+        {
+            kill(pids[i], signo);
+        }
+    }
+}
+
+/*
+*   Shut down the background jobs. With drain, wait for them to
+*   finish on their own first. Then send SIGTERM to the process group
+*   of each job left, wait up to grace ns for them, and SIGKILL any
+*   still running. Jobs are watched with pidfds and reaped as they
+*   finish. A job without a pidfd, if pidfd_open is not supported or
+*   out of descriptors, is still signalled and checked with waitpid.
+*   A summary is printed if there were any.
+*/
+void shutdownJobs(struct shellContext* shell, bool drain, long long grace)
+{
+    struct pollfd fds[MAX_COMMAND_LINE_ARGUMENTS];
+    pid_t pids[MAX_COMMAND_LINE_ARGUMENTS];
+    bool running[MAX_COMMAND_LINE_ARGUMENTS];
+    int childExitStatus;
+    int numJobs = 0;
+    int numFinished = 0;
+    int numTerminated;
+    int numKilled;
+    pid_t result;
+    int i;
+
+    for(i = 0; i < MAX_COMMAND_LINE_ARGUMENTS; i++)
+    {
+        if(shell->processIDs[i] == -1)
+        {
+            continue;
+        }
+
+        pids[numJobs] = shell->processIDs[i];
+        fds[numJobs].fd = syscall(SYS_pidfd_open, pids[numJobs], 0);
+        fds[numJobs].events = POLLIN;
+        if(fds[numJobs].fd == -1)
+        {
+            result = waitpid(pids[numJobs], &childExitStatus, WNOHANG);
+            if(result > 0)
+            {
+                reportBGProcess(shell, pids[numJobs], childExitStatus);
+            }
+            if(result != 0)
+            {
+                // Finished, or not a child any more and nothing to
+                // wait for
+                if(result == -1)
+                {
+                    finishBoardJob(shell, pids[numJobs], -1);
+                }
+                removeFromPIDList(shell, pids[numJobs]);
+                continue;
+            }
+        }
+        running[numJobs] = true;
+        numJobs++;
+    }
+    if(numJobs == 0)
+    {
+        return;
+    }
+
+    if(drain)
+    {
+        numFinished = waitForJobs(shell, pids, fds, running, numJobs, -1);
+    }
+
+    signalJobs(pids, running, numJobs, SIGTERM);
+    numTerminated = waitForJobs(shell, pids, fds, running, numJobs, monotonicNs() + grace);
+
+    signalJobs(pids, running, numJobs, SIGKILL);
+    numKilled = waitForJobs(shell, pids, fds, running, numJobs, -1);
+
+    printf("shutdown: %d background jobs, %d finished, %d stopped by SIGTERM, %d killed\n",
+        numJobs, numFinished, numTerminated, numKilled);
+    fflush(stdout);
+}
+
+/*
+*   Take out process ID from list of running ids
+*/
+void removeFromPIDList(struct shellContext* shell, int pid)
+{
+    int i;
+
+    for(i = 0; i < MAX_COMMAND_LINE_ARGUMENTS; i++)
+    {
+        if(shell->processIDs[i] == pid)
+        {
+            shell->processIDs[i] = -1;
+            shell->silentJobs[i] = false;
+            break;
+        }
+    }
+}
+
+/*
+*   Add process id to list of running IDs
+*/
+void addToPIDList(struct shellContext* shell, int pid)
+{
+    int i;
+
+    for(i = 0; i < MAX_COMMAND_LINE_ARGUMENTS; i++)
+    {
+        if(shell->processIDs[i] == -1)
+        {
+            shell->processIDs[i] = pid;
+            shell->silentJobs[i] = false;
+            break;
+        }
+    }
+}
+
+/*
+*   Add process id of a job that is reaped without a report, the job
+*   of a process substitution, to list of running IDs
+*/
+void addSilentJob(struct shellContext* shell, int pid)
+{
+    int i;
+
+    addToPIDList(shell, pid);
+    for(i = 0; i < MAX_COMMAND_LINE_ARGUMENTS; i++)
+    {
+        if(shell->processIDs[i] == pid)
+        {
+            shell->silentJobs[i] = true;
+            break;
+        }
+    }
+}
+
+/*
+*   Returns true if pid is a job that is reaped without a report.
+*/
+bool isSilentJob(struct shellContext* shell, int pid)
+{
+    int i;
+
+    for(i = 0; i < MAX_COMMAND_LINE_ARGUMENTS; i++)
+    {
+        if(shell->processIDs[i] == pid)
+        {
+            return shell->silentJobs[i];
+        }
+    }
+
+    return false;
+}
+
+/*
+*   Initialize process ID list
+*/
+void initializePIDList(struct shellContext* shell)
+{
+    int i;
+
+    for(i = 0; i < MAX_COMMAND_LINE_ARGUMENTS; i++)
+    {
+        shell->processIDs[i] = -1;
+        shell->silentJobs[i] = false;
+    }
+}
+
+/*
+*   Print how background job pid ended, from its wait status.
+*/
+void reportBGProcess(struct shellContext* shell, pid_t pid, int childExitStatus)
+{
+    if(isSilentJob(shell, pid))
+    {
+        removeDeadline(shell, pid);
+        return;
+    }
+    finishBoardJob(shell, pid, childExitStatus);
+
+    // Output captured from the job comes before its end
+    drainJobOutput(shell, pid);
+
+    if(removeDeadline(shell, pid))
+    {
+        printf("background pid %d is done: terminated by timeout\n", pid);
+    }
+    else if(WIFEXITED(childExitStatus))
+    {
+        printf("background pid %d is done: exit value %d\n", pid, WEXITSTATUS(childExitStatus));
+    }
+    else
+    {
+        printf("background pid %d is done: terminated by signal %d\n", pid, WTERMSIG(childExitStatus));
+    }
+    fflush(stdout);
+}
+
+/*
+*   Check all background processes and see which are running or not.
+*/
+void checkBGProcesses(struct shellContext* shell)
+{
+    int i;
+    int childExitStatus;
+    pid_t spawnpid = 0;
+
+    for(i = 0; i < MAX_COMMAND_LINE_ARGUMENTS; i++)
+    {
+        if(shell->processIDs[i] != -1)
+        {
+            // printf("Checking BG processID: %d\n", shell->processIDs[i]);
+            // fflush(stdout);
+            spawnpid = waitpid(shell->processIDs[i], &childExitStatus, WNOHANG);
+            
+            // printf("Parent's waiting is done as the child with pid %d exited\n", spawnpid);
+            // fflush(stdout);
+            
+            if(spawnpid == -1)
+            {
+                // Reaped elsewhere, there is no status to report
+                removeDeadline(shell, shell->processIDs[i]);
+                finishBoardJob(shell, shell->processIDs[i], -1);
+                shell->processIDs[i] = -1;
+            }
+            else if(spawnpid != 0)
+            {
+                reportBGProcess(shell, shell->processIDs[i], childExitStatus);
+
+                // take out of PID list
+                removeFromPIDList(shell, spawnpid);
+            }
+        }
+    }
+}
@@ -0,0 +1,774 @@
+/*
+*   Line lexing and expansion: splitting a command line into words,
+*   and expanding $$, variables, $(( ... )) arithmetic, $( ... )
+*   command substitutions and <( ... ) and >( ... ) process
+*   substitutions into fields.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "smallsh.h"
+
+/*
+*   Returns value of shell variable name. If there is no shell
+*   variable the environment is used, so $HOME and $PATH work.
+*/
+const char* getVariable(struct shellContext* shell, const char* name)
+{
+    const char* value = hashLookup(&shell->variables, name);
+
+    return value != NULL ? value : getEnvironmentValue(shell, name);
+}
+
+/*
+*   Set shell variable name to a copy of value. If it is exported its
+*   entry in the environment is changed too.
+*/
+void setVariable(struct shellContext* shell, const char* name, const char* value)
+{
+    free(hashInsert(&shell->variables, name, strdup(value)));
+    if(findEnvironmentSlot(shell, name, strlen(name)) != -1)
+    {
+        exportVariable(shell, name, value);
+    }
+}
+
+/*
+*   Returns length of the variable name at the start of text, 0 if
+*   text does not start with a name.
+*/
+int variableNameLength(const char* text)
+{
+    int len = 0;
+
+    if(!(text[0] == '_' || (text[0] >= 'a' && text[0] <= 'z') ||
+        (text[0] >= 'A' && text[0] <= 'Z')))
+    {
+        return 0;
+    }
+
+    while(text[len] == '_' || (text[len] >= 'a' && text[len] <= 'z') ||
+        (text[len] >= 'A' && text[len] <= 'Z') || (text[len] >= '0' && text[len] <= '9'))
+    {
+        len++;
+    }
+
+    return len;
+}
+
+/*
+*   Add word to list. Word must stay valid while the list is used.
+*/
+void addWord(struct wordList* list, char* word)
+{
+    if(list->numWords == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 16;
+        list->words = realloc(list->words, list->capacity * sizeof(char*));
+    }
+    list->words[list->numWords++] = word;
+}
+
+/*
+*   Add a malloc'd buffer to the buffers owned by list.
+*/
+void addOwnedBuffer(struct wordList* list, char* buffer)
+{
+    list->buffers = realloc(list->buffers, (list->numBuffers + 1) * sizeof(char*));
+    list->buffers[list->numBuffers++] = buffer;
+}
+
+/*
+*   Add fd, the shell end of a process substitution pipe, to the fds
+*   owned by list.
+*/
+void addOwnedFD(struct wordList* list, int fd)
+{
+    list->fds = realloc(list->fds, (list->numFDs + 1) * sizeof(int));
+    list->fds[list->numFDs++] = fd;
+}
+
+/*
+*   Close the process substitution fds owned by list.
+*/
+void closeOwnedFDs(struct wordList* list)
+{
+    int i;
+
+    for(i = 0; i < list->numFDs; i++)
+    {
+        close(list->fds[i]);
+    }
+    list->numFDs = 0;
+}
+
+/*
+*   Free the buffers and close the fds owned by list and empty it.
+*   The arrays are kept so the list can be reused without allocating
+*   again.
+*/
+void clearWordList(struct wordList* list)
+{
+    int i;
+
+    for(i = 0; i < list->numBuffers; i++)
+    {
+        free(list->buffers[i]);
+    }
+    list->numBuffers = 0;
+    list->numWords = 0;
+    closeOwnedFDs(list);
+}
+
+/*
+*   Find the end of a word that starts at line. Words are separated
+*   by spaces, except that a $( ... ) command substitution, a <( ... )
+*   or >( ... ) process substitution or a ${ ... } parameter
+*   expression is kept in one word even if it has spaces, counting
+*   nested parentheses and braces.
+*   Returns pointer to the char after the word.
+*/
+char* findWordEnd(char* line)
+{
+    int depth = 0;
+    char* c = line;
+
+    while(*c != 0 && (depth > 0 || *c != ' '))
+    {
+        if(((c[0] == '$' || c[0] == '<' || c[0] == '>') && c[1] == '(') || (c[0] == '$' && c[1] == '{'))
+        {
+            depth++;
+            c++;
+        }
+        else if(*c == '(' && depth > 0)
+        {
+            depth++;
+        }
+        else if((*c == ')' || *c == '}') && depth > 0)
+        {
+            depth--;
+        }
+        c++;
+    }
+
+    return c;
+}
+
+/*
+*   Get next word of the command line at *cursor and move cursor past
+*   it. Returns NULL if there are no more words. Word is terminated
+*   in place in the command line.
+*/
+char* nextWord(char** cursor)
+{
+    char* word = *cursor;
+    char* end;
+
+    while(*word == ' ')
+    {
+        word++;
+    }
+    if(*word == 0)
+    {
+        *cursor = word;
+        return NULL;
+    }
+
+    end = findWordEnd(word);
+    *cursor = *end != 0 ? end + 1 : end;
+    *end = 0;
+
+    return word;
+}
+
+/*
+*   Run innerLine in a forked child of the shell, whose stdin or
+*   stdout the caller has set up, and exit with its status. A single
+*   command that is not run by the shell is exec'd in the child
+*   itself. Does not return.
+*/
+void runSubstitutionChild(struct shellContext* shell, const char* innerLine)
+{
+    struct commandNode* innerNode;
+    struct commandElements* innerCommand;
+    char* lineCopy;
+
+    resetChildShell(shell);
+
+    lineCopy = strdup(innerLine);
+    innerNode = parseLine(shell, lineCopy, false);
+    if(innerNode == NULL)
+    {
+        _exit(0);
+    }
+
+    // A single command that is not built in is exec'd
+    // directly in this child
+    innerCommand = innerNode->command;
+    if(innerNode->type == NODE_COMMAND && innerNode->next == NULL &&
+        !innerCommand->isAssignment)
+    {
+        expandCommand(shell, innerCommand);
+        if(innerCommand->numArguments == 0)
+        {
+            _exit(0);
+        }
+        if(!isShellCommand(shell, innerCommand->commands[0]))
+        {
+            if(!planRedirections(shell, innerCommand))
+            {
+                _exit(1);
+            }
+            runFGChild(shell, innerCommand);
+        }
+    }
+    runNodeList(shell, innerNode);
+
+    // _exit so stdio does not move the stdin offset shared
+    // with the shell
+    fflush(stdout);
+    _exit(exitStatusCode(shell));
+}
+
+/*
+*   Runs innerLine in a child process with its stdout connected to a
+*   pipe, and reads all of the output into a buffer that grows by
+*   doubling. The child is reaped before returning. Trailing newlines
+*   are stripped. Returns the malloc'd buffer, which the caller owns.
+*/
+char* runCommandSubstitution(struct shellContext* shell, const char* innerLine)
+{
+    int pipeFDs[2];
+    int childExitStatus;
+    size_t capacity = 256;
+    size_t length = 0;
+    ssize_t n;
+    char* output = malloc(capacity);
+    pid_t spawnpid;
+
+    if(pipe(pipeFDs) == -1)
+    {
+        perror("pipe() failed!");
+        fflush(stderr);
+        output[0] = 0;
+        return output;
+    }
+
+    spawnpid = fork();
+    switch(spawnpid)
+    {
+        case -1:
+            perror("fork() failed!");
+            fflush(stderr);
+            close(pipeFDs[0]);
+            close(pipeFDs[1]);
+            output[0] = 0;
+            return output;
+        case 0:     // Child runs the inner command with stdout to pipe
+            close(pipeFDs[0]);
+            dup2(pipeFDs[1], STDOUT_FILENO);
+            close(pipeFDs[1]);
+            runSubstitutionChild(shell, innerLine);
+            // fall through - it never returns
+        default:    // Parent reads until child closes the pipe
+            close(pipeFDs[1]);
+            break;
+    }
+
+    while((n = read(pipeFDs[0], output + length, capacity - length - 1)) != 0)
+    {
+        if(n == -1)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        length += n;
+        if(capacity - length == 1)
+        {
+            capacity *= 2;
+            output = realloc(output, capacity);
+        }
+    }
+    close(pipeFDs[0]);
+
+    while(waitpid(spawnpid, &childExitStatus, 0) == -1 && errno == EINTR)
+    {
+    }
+
+    // Strip trailing newlines
+    while(length > 0 && output[length - 1] == '\n')
+    {
+        length--;
+    }
+    output[length] = 0;
+
+    return output;
+}
+
+/*
+*   Start innerLine as a process substitution, a job whose stdout for
+*   <( ... ), or stdin for >( ... ), is a pipe. The shell's end of the
+*   pipe is owned by fields until the command being expanded has it,
+*   and the returned malloc'd "/dev/fd/N" names it. The job is reaped
+*   by the job table without a report.
+*/
+char* startProcessSubstitution(struct shellContext* shell, const char* innerLine, bool isInput,
+    struct wordList* fields)
+{
+    char* path = malloc(32);
+    int pipeFDs[2];
+    int shellFD;
+    int childFD;
+    pid_t spawnpid;
+
+    path[0] = 0;
+    if(pipe2(pipeFDs, O_CLOEXEC) == -1)
+    {
+        perror("pipe() failed!");
+        fflush(stderr);
+        return path;
+    }
+
+    // The command reads what <( ) writes, and writes what >( ) reads
+    shellFD = moveToPlannedFD(pipeFDs[isInput ? 0 : 1]);
+    childFD = pipeFDs[isInput ? 1 : 0];
+
+    fflush(stdout);
+    spawnpid = fork();
+    switch(spawnpid)
+    {
+        case -1:
+            perror("fork() failed!");
+            fflush(stderr);
+            close(shellFD);
+            close(childFD);
+            return path;
+        case 0:     // Child runs the inner command on its end
+            closeOwnedFDs(fields);
+            close(shellFD);
+            dup2(childFD, isInput ? STDOUT_FILENO : STDIN_FILENO);
+            close(childFD);
+            runSubstitutionChild(shell, innerLine);
+            // fall through - it never returns
+        default:
+            close(childFD);
+            addSilentJob(shell, spawnpid);
+            addOwnedFD(fields, shellFD);
+            break;
+    }
+
+    sprintf(path, "/dev/fd/%d", shellFD);
+    return path;
+}
+
+/*
+*   Returns pointer to the ')' that closes the parenthesis before
+*   start, or to the end of the string if there is none.
+*/
+const char* findCloseParen(const char* start)
+{
+    const char* end;
+    int depth = 1;
+
+    for(end = start; *end != 0; end++)
+    {
+        if(*end == '(')
+        {
+            depth++;
+        }
+        else if(*end == ')' && --depth == 0)
+        {
+            break;
+        }
+    }
+
+    return end;
+}
+
+/*
+*   Returns pointer to the '}' that closes the ${ before start, or to
+*   the end of the string if there is none.
+*/
+const char* findCloseBrace(const char* start)
+{
+    const char* end;
+    int depth = 1;
+
+    for(end = start; *end != 0; end++)
+    {
+        if(end[0] == '\\' && end[1] != 0)
+        {
+            end++;
+        }
+        else if(end[0] == '$' && end[1] == '{')
+        {
+            depth++;
+            end++;
+        }
+        else if(*end == '}' && --depth == 0)
+        {
+            break;
+        }
+    }
+
+    return end;
+}
+
+/*
+*   Append len chars of text to the malloc'd string *field, which may
+*   be NULL.
+*/
+void appendToField(char** field, int* fieldLen, const char* text, int len)
+{
+    *field = realloc(*field, *fieldLen + len + 1);
+    memcpy(*field + *fieldLen, text, len);
+    *fieldLen += len;
+    (*field)[*fieldLen] = 0;
+}
+
+/*
+*   Split text, which is owned by fields, on whitespace. Text before
+*   it in *current joins its first piece, and its last piece is left
+*   in *current to join text after it. Pieces in between are added
+*   to fields in place, without copying.
+*/
+void addSplitText(char* text, struct wordList* fields, char** current, int* currentLen)
+{
+    char* saveptr;
+    char* piece = strtok_r(text, " \t\n", &saveptr);
+    char* nextPiece;
+
+    while(piece != NULL)
+    {
+        nextPiece = strtok_r(NULL, " \t\n", &saveptr);
+        if(*current == NULL && nextPiece != NULL)
+        {
+            addWord(fields, piece);
+        }
+        else
+        {
+            appendToField(current, currentLen, piece, strlen(piece));
+            if(nextPiece != NULL)
+            {
+                addOwnedBuffer(fields, *current);
+                addWord(fields, *current);
+                *current = NULL;
+                *currentLen = 0;
+            }
+        }
+        piece = nextPiece;
+    }
+}
+
+/*
+*   Expand the $(( ... )) arithmetic, $( ... ) command substitutions,
+*   <( ... ) and >( ... ) process substitutions, $NAME variables and
+*   ${ ... } parameter expressions in word and add the resulting
+*   fields to fields. An arithmetic error or a bad ${ ... } sets
+*   expansionFailed of shell. Word itself is not changed, so a parsed
+*   command can be expanded again on every run. If split, substitution output and variable values
+*   are split on whitespace, otherwise word expands to one field.
+*   Returns the number of fields added.
+*/
+int expandWord(struct shellContext* shell, const char* word, struct wordList* fields, bool split)
+{
+    char* current = NULL;   // field being built, NULL if none yet
+    int currentLen = 0;
+    int startWords = fields->numWords;
+    int nameLen, textLen, i;
+    const char* c = word;
+    const char* end;
+    const char* value;
+    long long number;
+    char* inner;
+    char* text;
+
+    while(*c != 0)
+    {
+        if(c[0] == '$' && c[1] == '(' && c[2] == '(' && *(end = findCloseParen(c + 3)) == ')' &&
+            end[1] == ')')
+        {
+            // Arithmetic, with variables and substitutions in it
+            // expanded first
+            inner = strndup(c + 3, end - (c + 3));
+            value = strchr(inner, '$') != NULL ? expandJoined(shell, inner, fields) : inner;
+            text = malloc(32);
+            if(evaluateArithmetic(shell, value, &number))
+            {
+                sprintf(text, "%lld", number);
+            }
+            else
+            {
+                text[0] = 0;
+                shell->expansionFailed = true;
+            }
+            free(inner);
+            c = end + 2;
+        }
+        else if((c[0] == '$' || c[0] == '<' || c[0] == '>') && c[1] == '(')
+        {
+            end = findCloseParen(c + 2);
+            inner = strndup(c + 2, end - (c + 2));
+            if(c[0] == '$')
+            {
+                text = runCommandSubstitution(shell, inner);
+            }
+            else
+            {
+                text = startProcessSubstitution(shell, inner, c[0] == '<', fields);
+            }
+            free(inner);
+            c = *end == ')' ? end + 1 : end;
+        }
+        else if(c[0] == '$' && c[1] == '{' && *(end = findCloseBrace(c + 2)) == '}')
+        {
+            inner = strndup(c + 2, end - (c + 2));
+            text = expandParameter(shell, inner, fields);
+            if(text == NULL)
+            {
+                text = strdup("");
+                shell->expansionFailed = true;
+            }
+            free(inner);
+            c = end + 1;
+        }
+        else if(c[0] == '$' && c[1] >= '1' && c[1] <= '9')
+        {
+            nameLen = c[1] - '1';
+            text = strdup(nameLen < shell->numPositionalArgs ? shell->positionalArgs[nameLen] : "");
+            c += 2;
+        }
+        else if(c[0] == '$' && c[1] == '#')
+        {
+            text = malloc(16);
+            sprintf(text, "%d", shell->numPositionalArgs);
+            c += 2;
+        }
+        else if(c[0] == '$' && c[1] == '@')
+        {
+            text = calloc(1, sizeof(char));
+            textLen = 0;
+            for(i = 0; i < shell->numPositionalArgs; i++)
+            {
+                appendToField(&text, &textLen, i > 0 ? " " : "", i > 0);
+                appendToField(&text, &textLen, shell->positionalArgs[i], strlen(shell->positionalArgs[i]));
+            }
+            c += 2;
+        }
+        else if(c[0] == '$' && (nameLen = variableNameLength(c + 1)) > 0)
+        {
+            text = strndup(c + 1, nameLen);
+            value = getVariable(shell, text);
+            free(text);
+            text = strdup(value ? value : "");
+            c += nameLen + 1;
+        }
+        else
+        {
+            // Copy literal text up to the next $, < or > at once
+            end = strpbrk(c + 1, "$<>");
+            if(end == NULL)
+            {
+                end = c + strlen(c);
+            }
+            appendToField(&current, &currentLen, c, end - c);
+            c = end;
+            continue;
+        }
+
+        if(split)
+        {
+            addOwnedBuffer(fields, text);
+            addSplitText(text, fields, &current, &currentLen);
+        }
+        else
+        {
+            appendToField(&current, &currentLen, text, strlen(text));
+            free(text);
+        }
+    }
+
+    if(current != NULL)
+    {
+        addOwnedBuffer(fields, current);
+        addWord(fields, current);
+    }
+
+    return fields->numWords - startWords;
+}
+
+/*
+*   Expand word without splitting it. Returns the expanded string,
+*   owned by fields but not left in the list.
+*/
+char* expandJoined(struct shellContext* shell, const char* word, struct wordList* fields)
+{
+    int start = fields->numWords;
+    char* joined;
+
+    if(expandWord(shell, word, fields, false) == 0)
+    {
+        joined = calloc(1, sizeof(char));
+        addOwnedBuffer(fields, joined);
+        return joined;
+    }
+
+    joined = fields->words[start];
+    fields->numWords = start;
+
+    return joined;
+}
+
+/*
+*   Returns true if word is a NAME=value variable assignment.
+*/
+bool isAssignmentWord(const char* word)
+{
+    int len = variableNameLength(word);
+
+    return len > 0 && word[len] == '=';
+}
+
+/*
+*   Expand the value of a NAME=value word without splitting it.
+*   Returns "NAME=value" as expanded, owned by fields.
+*/
+char* expandAssignment(struct shellContext* shell, const char* word, struct wordList* fields)
+{
+    int nameLen = strchr(word, '=') - word + 1;
+    char* value = expandJoined(shell, word + nameLen, fields);
+    int valueLen = strlen(value);
+    char* assignment = malloc(nameLen + valueLen + 1);
+
+    memcpy(assignment, word, nameLen);
+    memcpy(assignment + nameLen, value, valueLen + 1);
+    addOwnedBuffer(fields, assignment);
+
+    return assignment;
+}
+
+/*
+*   Expand the words of curCommand into commands, and its redirection
+*   words into file names, for one run. Memory of the previous run is
+*   released first.
+*/
+void expandCommand(struct shellContext* shell, struct commandElements* curCommand)
+{
+    struct wordList* expansion = &curCommand->expansion;
+    char* hereString;
+    char* withNewline;
+    size_t length;
+    int i;
+
+    releaseExpansion(curCommand);
+
+    for(i = 0; i < curCommand->numWords; i++)
+    {
+        expandWord(shell, curCommand->words[i], expansion, true);
+    }
+
+    // Arguments past the maximum are dropped
+    if(expansion->numWords > MAX_COMMAND_LINE_ARGUMENTS - 1)
+    {
+        expansion->numWords = MAX_COMMAND_LINE_ARGUMENTS - 1;
+    }
+    for(i = 0; i < expansion->numWords; i++)
+    {
+        curCommand->commands[i] = expansion->words[i];
+    }
+    curCommand->commands[i] = NULL;
+    curCommand->numArguments = expansion->numWords;
+
+    // NAME=value words before the command, for its environment
+    for(i = 0; i < curCommand->numAssignments; i++)
+    {
+        curCommand->overlay[i] = expandAssignment(shell, curCommand->assignments[i], expansion);
+    }
+
+    // Here-string is the expanded word and a newline. A here-document
+    // with variables or substitutions is expanded for this run, any
+    // other has one memory file opened again by each run.
+    if(curCommand->hereStringWord != NULL)
+    {
+        hereString = expandJoined(shell, curCommand->hereStringWord, expansion);
+        length = strlen(hereString);
+        withNewline = malloc(length + 1);
+        memcpy(withNewline, hereString, length);
+        withNewline[length] = '\n';
+        curCommand->inputFD = createSealedInput(withNewline, length + 1);
+        free(withNewline);
+    }
+    else if(curCommand->hereBody != NULL && curCommand->hereFD == -1)
+    {
+        hereString = expandJoined(shell, curCommand->hereBody, expansion);
+        curCommand->inputFD = createSealedInput(hereString, strlen(hereString));
+    }
+    else
+    {
+        curCommand->inputFD = reopenSealedInput(curCommand->hereFD);
+    }
+}
+
+/*
+*   Release memory and here-string input of the last run of
+*   curCommand.
+*/
+void releaseExpansion(struct commandElements* curCommand)
+{
+    clearWordList(&curCommand->expansion);
+    curCommand->commands[0] = NULL;
+    curCommand->numArguments = 0;
+    curCommand->redirectSource = NULL;
+    closeRedirections(curCommand);
+
+    if(curCommand->inputFD != -1)
+    {
+        close(curCommand->inputFD);
+    }
+    curCommand->inputFD = -1;
+}
+
+/*
+*   Finds instances of "$$" and replaces them with pid of shell.
+*/
+char* replaceString(char* commandLineCopy)
+{
+    char* tempLine = calloc(MAX_COMMAND_LINE_LENGTH, sizeof(char));
+    char spid[256];
+    char* found;
+    char* rest = commandLineCopy;
+    int spidLen;
+
+    // Change shell pid to string
+    spidLen = sprintf(spid, "%d", getpid());
+
+    // If $$ is not found, line is unchanged
+    if(strstr(commandLineCopy, "$$") == NULL)
+    {
+        free(tempLine);
+        return commandLineCopy;
+    }
+
+    // Copy text between each $$, and the pid in place of each $$.
+    // A lone $ is left alone so $( ... ) is kept.
+    while((found = strstr(rest, "$$")) != NULL &&
+        strlen(tempLine) + (found - rest) + spidLen < MAX_COMMAND_LINE_LENGTH)
+    {
+        strncat(tempLine, rest, found - rest);
+        strcat(tempLine, spid);
+        rest = found + 2;
+    }
+    strncat(tempLine, rest, MAX_COMMAND_LINE_LENGTH - 1 - strlen(tempLine));
+
+    return tempLine;
+}
@@ -0,0 +1,649 @@
+/*
+*   Line editing with tab completion, backed by an index of the
+*   executables in $PATH.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <termios.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "smallsh.h"
+
+/* struct for the index of executables found in $PATH */
+struct executableIndex
+{
+    char** names;       // sorted executable names, no duplicates
+    int numNames;
+    int capacity;
+    char* path;         // value of $PATH the index was built from
+    char** dirs;        // directories of path
+    time_t* dirMtimes;  // mtime of each dir, used if inotify unavailable
+    int numDirs;
+    int inotifyFD;      // watches on dirs, -1 if not available
+    bool built;
+};
+
+struct executableIndex execIndex = {0};
+
+/* struct for input read from stdin when it is not a terminal */
+struct inputBuffer
+{
+    char data[4096];
+    int start;
+    int end;
+};
+
+struct inputBuffer scriptInput = {0};
+
+/*
+*   Compare function for qsort and bsearch on the executable names.
+*/
+int compareNames(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/*
+*   Free everything held by the executable index and close its
+*   inotify watches.
+*/
+void clearExecutableIndex()
+{
+    int i;
+
+    for(i = 0; i < execIndex.numNames; i++)
+    {
+        free(execIndex.names[i]);
+    }
+    for(i = 0; i < execIndex.numDirs; i++)
+    {
+        free(execIndex.dirs[i]);
+    }
+    free(execIndex.names);
+    free(execIndex.dirs);
+    free(execIndex.dirMtimes);
+    free(execIndex.path);
+
+    if(execIndex.built && execIndex.inotifyFD != -1)
+    {
+        close(execIndex.inotifyFD);
+    }
+
+    memset(&execIndex, 0, sizeof(execIndex));
+    execIndex.inotifyFD = -1;
+}
+
+/*
+*   Add every executable regular file in dir to the index.
+*/
+void scanExecutableDir(const char* dir)
+{
+    DIR* dirp = opendir(dir);
+    struct dirent* entry;
+    struct stat st;
+    char fullPath[4096];
+
+    if(dirp == NULL)
+    {
+        return;
+    }
+
+    while((entry = readdir(dirp)) != NULL)
+    {
+        if(entry->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        snprintf(fullPath, sizeof(fullPath), "%s/%s", dir, entry->d_name);
+        if(stat(fullPath, &st) == -1 || !S_ISREG(st.st_mode) ||
+            access(fullPath, X_OK) == -1)
+        {
+            continue;
+        }
+
+        if(execIndex.numNames == execIndex.capacity)
+        {
+            execIndex.capacity = execIndex.capacity ? execIndex.capacity * 2 : 256;
+            execIndex.names = realloc(execIndex.names, execIndex.capacity * sizeof(char*));
+        }
+        execIndex.names[execIndex.numNames++] = strdup(entry->d_name);
+    }
+
+    closedir(dirp);
+}
+
+/*
+*   Build the index of executables from every directory in $PATH of
+*   shell, which export or an assignment may have changed. Each
+*   directory gets an inotify watch so the index is only rebuilt
+*   when a directory actually changes. If inotify is not available,
+*   the mtime of each directory is saved and checked instead.
+*/
+void buildExecutableIndex(struct shellContext* shell)
+{
+    const char* path = getVariable(shell, "PATH");
+    char* pathCopy;
+    char* saveptr;
+    char* dir;
+    struct stat st;
+    int i, j;
+
+    clearExecutableIndex();
+    execIndex.built = true;
+    execIndex.path = strdup(path ? path : "");
+    execIndex.inotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    pathCopy = strdup(execIndex.path);
+    for(dir = strtok_r(pathCopy, ":", &saveptr); dir != NULL;
+        dir = strtok_r(NULL, ":", &saveptr))
+    {
+        execIndex.dirs = realloc(execIndex.dirs, (execIndex.numDirs + 1) * sizeof(char*));
+        execIndex.dirMtimes = realloc(execIndex.dirMtimes, (execIndex.numDirs + 1) * sizeof(time_t));
+        execIndex.dirs[execIndex.numDirs] = strdup(dir);
+        execIndex.dirMtimes[execIndex.numDirs] = stat(dir, &st) == 0 ? st.st_mtime : 0;
+        execIndex.numDirs++;
+
+        if(execIndex.inotifyFD != -1)
+        {
+            inotify_add_watch(execIndex.inotifyFD, dir,
+                IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB |
+                IN_DELETE_SELF | IN_MOVE_SELF);
+        }
+
+        scanExecutableDir(dir);
+    }
+    free(pathCopy);
+
+    // Sort, then drop names found in more than one directory
+    qsort(execIndex.names, execIndex.numNames, sizeof(char*), compareNames);
+    for(i = 0, j = 0; i < execIndex.numNames; i++)
+    {
+        if(j > 0 && strcmp(execIndex.names[j - 1], execIndex.names[i]) == 0)
+        {
+            free(execIndex.names[i]);
+            continue;
+        }
+        execIndex.names[j++] = execIndex.names[i];
+    }
+    execIndex.numNames = j;
+}
+
+/*
+*   Rebuild the executable index only if it is stale: $PATH of shell
+*   changed, an inotify event arrived for one of the directories, or
+*   (without inotify) a directory's mtime changed.
+*/
+void refreshExecutableIndex(struct shellContext* shell)
+{
+    const char* path = getVariable(shell, "PATH");
+    char events[4096];
+    bool stale = false;
+    struct stat st;
+    int i;
+
+    if(!execIndex.built || strcmp(execIndex.path, path ? path : "") != 0)
+    {
+        buildExecutableIndex(shell);
+        return;
+    }
+
+    if(execIndex.inotifyFD != -1)
+    {
+        // Drain all pending events, any event makes the index stale
+        while(read(execIndex.inotifyFD, events, sizeof(events)) > 0)
+        {
+            stale = true;
+        }
+    }
+    else
+    {
+        for(i = 0; i < execIndex.numDirs && !stale; i++)
+        {
+            if(stat(execIndex.dirs[i], &st) == 0 && st.st_mtime != execIndex.dirMtimes[i])
+            {
+                stale = true;
+            }
+        }
+    }
+
+    if(stale)
+    {
+        buildExecutableIndex(shell);
+    }
+}
+
+/*
+*   Add a match to the list of completions if it is not already
+*   there, as found in seen, the table of the matches so far.
+*/
+void addCompletion(char*** matches, int* numMatches, struct hashTable* seen, const char* name,
+    bool isDir)
+{
+    if(hashLookup(seen, name) != NULL)
+    {
+        return;
+    }
+    hashInsert(seen, name, seen);
+
+    *matches = realloc(*matches, (*numMatches + 1) * sizeof(char*));
+    (*matches)[*numMatches] = calloc(strlen(name) + 2, sizeof(char));
+    strcpy((*matches)[*numMatches], name);
+    if(isDir)
+    {
+        strcat((*matches)[*numMatches], "/");
+    }
+    (*numMatches)++;
+}
+
+/*
+*   Add keys of table starting with prefix to the completions.
+*/
+void addTableCompletions(struct hashTable* table, const char* prefix, char*** matches,
+    int* numMatches, struct hashTable* seen)
+{
+    struct hashEntry* entry;
+    int i;
+
+    for(i = 0; i < table->numBuckets; i++)
+    {
+        for(entry = table->buckets[i]; entry != NULL; entry = entry->next)
+        {
+            if(strncmp(entry->key, prefix, strlen(prefix)) == 0)
+            {
+                addCompletion(matches, numMatches, seen, entry->key, false);
+            }
+        }
+    }
+}
+
+/*
+*   Find built in commands, functions, aliases and indexed
+*   executables starting with prefix. The index is sorted so matches
+*   are found by a binary search for the first name not less than
+*   prefix.
+*/
+int findCommandCompletions(struct shellContext* shell, const char* prefix, char*** matches)
+{
+    struct hashTable seen = {0};
+    int numMatches = 0;
+    int len = strlen(prefix);
+    int low = 0;
+    int high;
+    int mid, i;
+
+    for(i = 0; i < NUM_BUILT_INS; i++)
+    {
+        if(strncmp(builtInCommands[i], prefix, len) == 0)
+        {
+            addCompletion(matches, &numMatches, &seen, builtInCommands[i], false);
+        }
+    }
+    addTableCompletions(&shell->functions, prefix, matches, &numMatches, &seen);
+    addTableCompletions(&shell->aliases, prefix, matches, &numMatches, &seen);
+
+    refreshExecutableIndex(shell);
+
+    high = execIndex.numNames;
+    while(low < high)
+    {
+        mid = (low + high) / 2;
+        if(strcmp(execIndex.names[mid], prefix) < 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    for(i = low; i < execIndex.numNames && strncmp(execIndex.names[i], prefix, len) == 0; i++)
+    {
+        addCompletion(matches, &numMatches, &seen, execIndex.names[i], false);
+    }
+
+    clearHashTable(&seen);
+    return numMatches;
+}
+
+/*
+*   Find files in the directory part of word whose names start with
+*   the last path component of word. Matches keep the directory part
+*   so they can replace word as a whole.
+*/
+int findFileCompletions(const char* word, char*** matches)
+{
+    struct hashTable seen = {0};
+    int numMatches = 0;
+    const char* slash = strrchr(word, '/');
+    const char* base = slash ? slash + 1 : word;
+    char dir[MAX_COMMAND_LINE_LENGTH];
+    char name[MAX_COMMAND_LINE_LENGTH + 256];
+    struct dirent* entry;
+    struct stat st;
+    DIR* dirp;
+    int dirLen = slash ? slash - word + 1 : 0;
+
+    if(dirLen > 0)
+    {
+        memcpy(dir, word, dirLen);
+        dir[dirLen] = 0;
+    }
+    else
+    {
+        strcpy(dir, "./");
+    }
+
+    dirp = opendir(dir);
+    if(dirp == NULL)
+    {
+        return 0;
+    }
+
+    while((entry = readdir(dirp)) != NULL)
+    {
+        // Hidden files are only offered if asked for
+        if(entry->d_name[0] == '.' && base[0] != '.')
+        {
+            continue;
+        }
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0 ||
+            strncmp(entry->d_name, base, strlen(base)) != 0)
+        {
+            continue;
+        }
+
+        snprintf(name, sizeof(name), "%s%s", dirLen > 0 ? dir : "", entry->d_name);
+        addCompletion(matches, &numMatches, &seen, name,
+            stat(name, &st) == 0 && S_ISDIR(st.st_mode));
+    }
+
+    closedir(dirp);
+    clearHashTable(&seen);
+    qsort(*matches, numMatches, sizeof(char*), compareNames);
+
+    return numMatches;
+}
+
+/*
+*   Complete the word before the end of the line. The first word of a
+*   line is completed as a command, unless it contains '/', any other
+*   word is completed as a file name. A single match replaces the
+*   word, several matches extend it to their longest common prefix,
+*   and if that adds nothing and tab was pressed twice the matches
+*   are listed.
+*/
+void completeLine(struct shellContext* shell, char* line, int* len, int size, bool listMatches)
+{
+    char** matches = NULL;
+    int numMatches, i, common;
+    int wordStart = *len;
+    bool isCommand = true;
+    char word[MAX_COMMAND_LINE_LENGTH];
+
+    while(wordStart > 0 && line[wordStart - 1] != ' ')
+    {
+        wordStart--;
+    }
+    for(i = 0; i < wordStart; i++)
+    {
+        if(line[i] != ' ')
+        {
+            isCommand = false;
+            break;
+        }
+    }
+
+    memcpy(word, line + wordStart, *len - wordStart);
+    word[*len - wordStart] = 0;
+
+    if(isCommand && strchr(word, '/') == NULL)
+    {
+        numMatches = findCommandCompletions(shell, word, &matches);
+    }
+    else
+    {
+        numMatches = findFileCompletions(word, &matches);
+    }
+
+    if(numMatches == 0)
+    {
+        write(STDOUT_FILENO, "\a", 1);
+        return;
+    }
+
+    // Longest common prefix of all matches
+    common = strlen(matches[0]);
+    for(i = 1; i < numMatches; i++)
+    {
+        while(strncmp(matches[0], matches[i], common) != 0)
+        {
+            common--;
+        }
+    }
+
+    if(common > (int)strlen(word) && wordStart + common < size - 2)
+    {
+        // Echo and store only the part not typed yet
+        write(STDOUT_FILENO, matches[0] + (*len - wordStart), common - (*len - wordStart));
+        memcpy(line + wordStart, matches[0], common);
+        *len = wordStart + common;
+
+        if(numMatches == 1 && matches[0][common - 1] != '/')
+        {
+            line[(*len)++] = ' ';
+            write(STDOUT_FILENO, " ", 1);
+        }
+    }
+    else if(numMatches > 1 && listMatches)
+    {
+        printf("\n");
+        for(i = 0; i < numMatches; i++)
+        {
+            printf("%s  ", matches[i]);
+        }
+        printf("\n: %.*s", *len, line);
+        fflush(stdout);
+    }
+    else if(numMatches > 1)
+    {
+        write(STDOUT_FILENO, "\a", 1);
+    }
+
+    for(i = 0; i < numMatches; i++)
+    {
+        free(matches[i]);
+    }
+    free(matches);
+}
+
+/*
+*   Read a line of the script, stdin when it is not a terminal or the
+*   text of -c, like fgets. The shell buffers the input itself so it
+*   knows when the buffer is empty, and only then waits for the script
+*   in the event loop. Returns false at end of file.
+*/
+bool readScriptLine(struct shellContext* shell, char* line, int size)
+{
+    struct inputBuffer* input = &scriptInput;
+    char* newline;
+    int len = 0;
+    int count;
+    ssize_t n;
+
+    while(len < size - 1)
+    {
+        if(input->start == input->end)
+        {
+            if(!waitForInput(shell))
+            {
+                continue;
+            }
+            n = read(shell->scriptFD, input->data, sizeof(input->data));
+            if(n == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            if(n <= 0)
+            {
+                break;
+            }
+            input->start = 0;
+            input->end = n;
+        }
+
+        // Copy up to and with the newline, as much as fits
+        count = input->end - input->start;
+        if(count > size - 1 - len)
+        {
+            count = size - 1 - len;
+        }
+        newline = memchr(input->data + input->start, '\n', count);
+        if(newline != NULL)
+        {
+            count = newline - (input->data + input->start) + 1;
+        }
+        memcpy(line + len, input->data + input->start, count);
+        input->start += count;
+        len += count;
+        if(newline != NULL)
+        {
+            break;
+        }
+    }
+
+    line[len] = 0;
+    return len > 0;
+}
+
+/*
+*   Returns true if the script has no lines left after the one just
+*   read, as far as can be told without waiting: the buffer is empty
+*   and a read that does not block finds end of file. Data it reads is
+*   kept for the next line. A terminal is never exhausted.
+*/
+bool isInputExhausted(struct shellContext* shell)
+{
+    struct inputBuffer* input = &scriptInput;
+    struct pollfd ready = {shell->scriptFD, POLLIN, 0};
+    ssize_t n;
+
+    if(input->start != input->end || isatty(shell->scriptFD) || poll(&ready, 1, 0) != 1)
+    {
+        return false;
+    }
+
+    n = read(shell->scriptFD, input->data, sizeof(input->data));
+    if(n <= 0)
+    {
+        return n == 0;
+    }
+    input->start = 0;
+    input->end = n;
+    return false;
+}
+
+/*
+*   Read a line from a terminal with editing and tab completion.
+*   Terminal is put in non canonical mode without echo for the line,
+*   SIGINT and SIGTSTP are still generated by the terminal. Returns
+*   false at end of file. If the script is not a terminal, the line is
+*   read by readScriptLine.
+*/
+bool readCommandLine(struct shellContext* shell, char* line, int size)
+{
+    struct termios original, raw;
+    bool lastWasTab = false;
+    int len = 0;
+    unsigned char c;
+    ssize_t n;
+
+    if(shell->scriptFD != STDIN_FILENO || !isatty(STDIN_FILENO) ||
+        tcgetattr(STDIN_FILENO, &original) == -1)
+    {
+        return readScriptLine(shell, line, size);
+    }
+
+    raw = original;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+
+    while(true)
+    {
+        // Deadlines and job output are handled while waiting for a key
+        if(!waitForInput(shell))
+        {
+            printf(": %.*s", len, line);
+            fflush(stdout);
+            continue;
+        }
+        n = read(STDIN_FILENO, &c, 1);
+        if(n == -1 && errno == EINTR)
+        {
+            // Signal handler printed a message, so reprint the line
+            printf(": %.*s", len, line);
+            fflush(stdout);
+            continue;
+        }
+        if(n <= 0 || (c == 4 && len == 0))  // EOF or ctrl-D on empty line
+        {
+            tcsetattr(STDIN_FILENO, TCSAFLUSH, &original);
+            return false;
+        }
+
+        if(c == '\n' || c == '\r')
+        {
+            write(STDOUT_FILENO, "\n", 1);
+            break;
+        }
+        else if(c == '\t')
+        {
+            completeLine(shell, line, &len, size, lastWasTab);
+            lastWasTab = true;
+            continue;
+        }
+        else if((c == 127 || c == '\b') && len > 0)
+        {
+            // A UTF-8 char is erased with its continuation bytes
+            while(len > 1 && ((unsigned char)line[len - 1] & 0xc0) == 0x80)
+            {
+                len--;
+            }
+            len--;
+            write(STDOUT_FILENO, "\b \b", 3);
+        }
+        else if(c == 21)    // ctrl-U erases the whole line
+        {
+            while(len > 0)
+            {
+                len--;
+                if(((unsigned char)line[len] & 0xc0) != 0x80)
+                {
+                    write(STDOUT_FILENO, "\b \b", 3);
+                }
+            }
+        }
+        else if(c >= ' ' && c != 127 && len < size - 2)
+        {
+            // Bytes of UTF-8 chars, 0x80 and up, are kept as typed
+            line[len++] = c;
+            write(STDOUT_FILENO, &c, 1);
+        }
+        lastWasTab = false;
+    }
+
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &original);
+    line[len] = 0;
+
+    return true;
+}
@@ -0,0 +1,307 @@
+/*
+*   The onchange built in: a command is run again each time a path it
+*   watches changes. Changes are seen with inotify and a burst of them
+*   is coalesced by a debounce timerfd, so a watch that is idle uses no
+*   CPU and a rerun starts as soon as the burst is over.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+#include <sys/syscall.h>
+
+#include "smallsh.h"
+
+#define CHANGE_EVENTS (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | \
+    IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+/* struct for the paths watched by one onchange */
+struct changeWatch
+{
+    char** paths;
+    int* watches;       // inotify watch of each path, -1 if it is lost
+    int numPaths;
+    int inotifyFD;
+    int debounceFD;     // timerfd armed by the last change
+    long long debounce; // ns a burst of changes must be quiet for
+};
+
+// Set by SIGINT, which ends onchange
+volatile sig_atomic_t changeInterrupted = 0;
+
+/*
+*   Handle SIGINT while onchange waits for changes.
+*/
+void handleChangeSIGINT(int signo)
+{
+    (void)signo;
+    changeInterrupted = 1;
+}
+
+/*
+*   Catch SIGINT so the wait for changes is interrupted. Running a
+*   foreground child sets it back to ignored, so this is done again
+*   before each wait.
+*/
+void catchChangeSIGINT()
+{
+    struct sigaction action = {0};
+
+    action.sa_handler = handleChangeSIGINT;
+    sigfillset(&action.sa_mask);
+    action.sa_flags = 0;    // no SA_RESTART, poll must return
+    sigaction(SIGINT, &action, NULL);
+}
+
+/*
+*   Add a watch for each path that has none, for the paths given and
+*   for a file that was replaced, which loses its watch. Returns the
+*   number of paths watched.
+*/
+int addChangeWatches(struct changeWatch* watch)
+{
+    int numWatched = 0;
+    int i;
+
+    for(i = 0; i < watch->numPaths; i++)
+    {
+        if(watch->watches[i] == -1)
+        {
+            watch->watches[i] = inotify_add_watch(watch->inotifyFD, watch->paths[i], CHANGE_EVENTS);
+        }
+        numWatched += watch->watches[i] != -1;
+    }
+
+    return numWatched;
+}
+
+/*
+*   Read the pending inotify events and arm the debounce timer, so a
+*   rerun waits until changes stop for the debounce time. A path whose
+*   watch was removed, because it was deleted or replaced, is watched
+*   again when the timer fires.
+*/
+void readChanges(struct changeWatch* watch)
+{
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct inotify_event* event;
+    struct itimerspec timer = {0};
+    ssize_t n;
+    char* p;
+    int i;
+
+    while((n = read(watch->inotifyFD, buffer, sizeof(buffer))) > 0)
+    {
+        for(p = buffer; p < buffer + n; p += sizeof(struct inotify_event) + event->len)
+        {
+            event = (struct inotify_event*)p;
+            for(i = 0; i < watch->numPaths && (event->mask & IN_IGNORED); i++)
+            {
+                if(watch->watches[i] == event->wd)
+                {
+                    watch->watches[i] = -1;
+                }
+            }
+        }
+    }
+
+    timer.it_value.tv_sec = watch->debounce / 1000000000LL;
+    timer.it_value.tv_nsec = watch->debounce % 1000000000LL;
+    if(watch->debounce == 0)
+    {
+        timer.it_value.tv_nsec = 1;     // 0 would disarm it
+    }
+    timerfd_settime(watch->debounceFD, 0, &timer, NULL);
+}
+
+/*
+*   Start a run of curCommand, in a foreground child that is not
+*   waited for here, or as a background job. Returns the pid, or -1 if
+*   it could not be started.
+*/
+pid_t startChangeRun(struct shellContext* shell, struct commandElements* curCommand)
+{
+    if(!planRedirections(shell, curCommand))
+    {
+        strcpy(shell->exitStatus, "exit value 1");
+        return -1;
+    }
+    if(curCommand->bg)
+    {
+        return runBGProcess(shell, curCommand);
+    }
+
+    return startFGProcess(shell, curCommand);
+}
+
+/*
+*   Runs the built in command onchange [-d DURATION] [-k] [-n COUNT]
+*   PATH... -- COMMAND [ARG]... COMMAND is run, then run again after
+*   each change to a PATH once changes stop for DURATION, 0.02s by
+*   default. A run in the foreground is waited for as usual, and one
+*   with & is a background job. A change during a run starts the next
+*   run after it, or with -k sends the run SIGTERM. It ends on SIGINT
+*   or after COUNT runs.
+*/
+void runOnchangeCommand(struct shellContext* shell, struct commandElements* curCommand)
+{
+    struct changeWatch watch = {0};
+    long long count = -1;
+    bool cancel = false;
+    bool pending = false;
+    uint64_t expirations;
+    pid_t runPID = -1;
+    int waited[3];
+    int runFD = -1;
+    int ready;
+    int i = 1;
+    int first;
+
+    watch.debounce = DEFAULT_ONCHANGE_DEBOUNCE;
+    while(i < curCommand->numArguments && curCommand->commands[i][0] == '-' &&
+        strcmp(curCommand->commands[i], "--") != 0 && watch.debounce != -1 && count != 0)
+    {
+        if(strcmp(curCommand->commands[i], "-k") == 0)
+        {
+            cancel = true;
+        }
+        else if(strcmp(curCommand->commands[i], "-d") == 0 && i + 1 < curCommand->numArguments)
+        {
+            watch.debounce = parseDuration(curCommand->commands[++i]);
+        }
+        else if(strcmp(curCommand->commands[i], "-n") == 0 && i + 1 < curCommand->numArguments)
+        {
+            count = atoll(curCommand->commands[++i]);
+        }
+        else
+        {
+            break;
+        }
+        i++;
+    }
+
+    first = i;
+    while(i < curCommand->numArguments && strcmp(curCommand->commands[i], "--") != 0)
+    {
+        i++;
+    }
+    if(watch.debounce == -1 || count == 0 || i == first || i + 1 >= curCommand->numArguments ||
+        curCommand->commands[first][0] == '-')
+    {
+        fprintf(stderr, "usage: onchange [-d DURATION] [-k] [-n COUNT] PATH... -- COMMAND [ARG]...\n");
+        fflush(stderr);
+        strcpy(shell->exitStatus, "exit value 2");
+        return;
+    }
+
+    // The paths are kept apart from the words, which are moved below
+    watch.numPaths = i - first;
+    watch.paths = malloc(watch.numPaths * sizeof(char*));
+    memcpy(watch.paths, curCommand->commands + first, watch.numPaths * sizeof(char*));
+    watch.watches = malloc(watch.numPaths * sizeof(int));
+    memset(watch.watches, -1, watch.numPaths * sizeof(int));
+    watch.inotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    watch.debounceFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(watch.inotifyFD == -1 || watch.debounceFD == -1 || addChangeWatches(&watch) == 0)
+    {
+        fprintf(stderr, "onchange: %s: %s\n", watch.paths[0], strerror(errno));
+        fflush(stderr);
+        strcpy(shell->exitStatus, "exit value 1");
+        count = 0;
+    }
+
+    // Run the words after -- as the command, with its NULL
+    i++;
+    memmove(curCommand->commands, curCommand->commands + i,
+        (curCommand->numArguments - i + 1) * sizeof(char*));
+    curCommand->numArguments -= i;
+
+    changeInterrupted = 0;
+    pending = count != 0;
+    while(!changeInterrupted)
+    {
+        // Start the next run once the last one is over
+        if(pending && runPID == -1)
+        {
+            pending = false;
+            runPID = startChangeRun(shell, curCommand);
+            runFD = runPID > 0 ? syscall(SYS_pidfd_open, runPID, 0) : -1;
+            if(runPID > 0 && runFD == -1 && !curCommand->bg)
+            {
+                // Without a pidfd the run can only be waited for
+                runFGParent(shell, runPID, curCommand);
+                runPID = -1;
+            }
+            if(runFD == -1)
+            {
+                runPID = -1;
+            }
+            count -= count > 0;
+        }
+        if(count == 0 && runPID == -1)
+        {
+            break;
+        }
+
+        catchChangeSIGINT();
+        waited[0] = runFD;
+        waited[1] = watch.inotifyFD;
+        waited[2] = watch.debounceFD;
+        ready = waitForEvents(shell, waited, 3);
+
+        if(ready == 0)
+        {
+            // A foreground run is reaped like any other, a background
+            // job by the job table
+            if(!curCommand->bg)
+            {
+                runFGParent(shell, runPID, curCommand);
+            }
+            close(runFD);
+            runFD = -1;
+            runPID = -1;
+        }
+        else if(ready == 1)
+        {
+            readChanges(&watch);
+        }
+        else if(ready == 2 && read(watch.debounceFD, &expirations, sizeof(expirations)) > 0)
+        {
+            addChangeWatches(&watch);
+            pending = count != 0;
+            if(pending && cancel && runPID != -1)
+            {
+                kill(curCommand->bg ? -runPID : runPID, SIGTERM);
+            }
+        }
+    }
+
+    // SIGINT ended the watch, the run it did not stop is waited for
+    if(runPID != -1 && !curCommand->bg)
+    {
+        runFGParent(shell, runPID, curCommand);
+    }
+    if(runFD != -1)
+    {
+        close(runFD);
+    }
+    SIGINT_action.sa_handler = SIG_IGN;
+    sigaction(SIGINT, &SIGINT_action, NULL);
+
+    if(watch.inotifyFD != -1)
+    {
+        close(watch.inotifyFD);
+    }
+    if(watch.debounceFD != -1)
+    {
+        close(watch.debounceFD);
+    }
+    free(watch.watches);
+    free(watch.paths);
+}
@@ -0,0 +1,599 @@
+/*
+*   smallsh --parallel [-j N] SCRIPT: the lines of a script are run
+*   concurrently where they can not affect each other, on up to N
+*   worker children, one per core by default. Each line is a step.
+*   A step depends on an earlier one if either writes a file the other
+*   reads or writes, as seen in their redirections and in the words
+*   that name a file an earlier step writes. Only > and >> and the
+*   arguments of the commands in writerCommands count as writes, so a
+*   line that writes a file any other way must be followed by wait
+*   before a line that reads it. A line that changes the
+*   shell, like cd, export or a function definition, or a line that is
+*   only "wait", is a barrier that runs in the shell once every step
+*   before it is done. The output of each worker is kept in memory
+*   files and replayed in script order, so the output reads as if the
+*   steps had run one after another.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+#include "smallsh.h"
+
+#define PARALLEL_WINDOW 256     // steps started but not yet replayed
+
+// Built ins that change or read the state of the shell
+const char* barrierCommands[] = {"exit", "cd", "status", "alias", "unalias", "joblog",
+    "export", "unset", "onchange", "exec", "let", "wait", NULL};
+
+// Commands that may write or remove any file named in their arguments
+const char* writerCommands[] = {"cp", "mv", "rm", "ln", "touch", "mkdir", "rmdir",
+    "install", "truncate", "tee", NULL};
+
+/* struct for one line of a parallel script */
+struct parallelStep
+{
+    struct commandNode* nodes;
+    bool isBarrier;
+    char* reads[MAX_COMMAND_LINE_ARGUMENTS];    // < files and words
+    int numReads;
+    char* writes[MAX_COMMAND_LINE_ARGUMENTS];   // > and >> files and
+                                                // words of writers
+    int numWrites;
+    int* deps;          // earlier steps it must wait for
+    int numDeps;
+    pid_t pid;          // worker running it, or -1
+    int pidFD;
+    int outFD;          // memory files with its stdout and stderr
+    int errFD;
+    bool done;
+    char status[64];
+};
+
+/*
+*   Returns path without a leading "./", so two names of a file in
+*   the cwd compare equal.
+*/
+const char* trimPath(const char* path)
+{
+    while(path[0] == '.' && path[1] == '/')
+    {
+        path += 2;
+    }
+
+    return path;
+}
+
+/*
+*   Returns true if path is one of the numPaths in paths.
+*/
+bool hasPath(char** paths, int numPaths, const char* path)
+{
+    int i;
+
+    for(i = 0; i < numPaths; i++)
+    {
+        if(strcmp(trimPath(paths[i]), trimPath(path)) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+*   Returns true if command of a step must run in the shell: a built
+*   in that changes or reads its state, a function or alias of the
+*   shell or of definedNames, those the script defines, or a word that
+*   is only known when it is expanded.
+*/
+bool isBarrierCommand(struct shellContext* shell, struct hashTable* definedNames,
+    struct commandElements* command)
+{
+    const char* name = command->numWords > 0 ? command->words[0] : "";
+    int i;
+
+    if(command->isAssignment || strchr(name, '$') != NULL || hashLookup(&shell->functions, name) != NULL ||
+        hashLookup(&shell->aliases, name) != NULL || hashLookup(definedNames, name) != NULL)
+    {
+        return true;
+    }
+    for(i = 0; barrierCommands[i] != NULL; i++)
+    {
+        if(strcmp(name, barrierCommands[i]) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+*   Returns true if command is one of writerCommands.
+*/
+bool isWriterCommand(struct commandElements* command)
+{
+    const char* name = command->numWords > 0 ? command->words[0] : "";
+    int i;
+
+    for(i = 0; writerCommands[i] != NULL; i++)
+    {
+        if(strcmp(name, writerCommands[i]) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+*   Add the names of the functions and aliases step defines to
+*   definedNames, so later steps that use them are barriers.
+*/
+void addDefinedNames(struct hashTable* definedNames, struct parallelStep* step)
+{
+    struct commandNode* node;
+    char name[MAX_COMMAND_LINE_LENGTH];
+    int i;
+
+    for(node = step->nodes; node != NULL; node = node->next)
+    {
+        if(node->type == NODE_FUNCTION)
+        {
+            hashInsert(definedNames, node->variable, "");
+        }
+        else if(node->type == NODE_COMMAND && node->command->numWords > 0 &&
+            strcmp(node->command->words[0], "alias") == 0)
+        {
+            for(i = 1; i < node->command->numWords; i++)
+            {
+                snprintf(name, sizeof(name), "%s", node->command->words[i]);
+                name[strcspn(name, "=")] = 0;
+                hashInsert(definedNames, name, "");
+            }
+        }
+    }
+}
+
+/*
+*   Free the entries of definedNames.
+*/
+void freeDefinedNames(struct hashTable* definedNames)
+{
+    struct hashEntry* entry;
+    struct hashEntry* next;
+    int i;
+
+    for(i = 0; i < definedNames->numBuckets; i++)
+    {
+        for(entry = definedNames->buckets[i]; entry != NULL; entry = next)
+        {
+            next = entry->next;
+            free(entry->key);
+            free(entry);
+        }
+    }
+    free(definedNames->buckets);
+}
+
+/*
+*   Find the files step reads and writes, or mark it a barrier. Only
+*   a line of plain commands can run in a worker, and only if the
+*   files they redirect are named without expansion.
+*/
+void analyzeStep(struct shellContext* shell, struct hashTable* definedNames, struct parallelStep* step)
+{
+    struct commandElements* command;
+    struct redirection* redirect;
+    struct commandNode* node;
+    int i;
+
+    for(node = step->nodes; node != NULL && !step->isBarrier; node = node->next)
+    {
+        command = node->command;
+        if(node->type != NODE_COMMAND || isBarrierCommand(shell, definedNames, command))
+        {
+            step->isBarrier = true;
+            break;
+        }
+
+        for(i = 1; i < command->numWords && step->numReads < MAX_COMMAND_LINE_ARGUMENTS; i++)
+        {
+            step->reads[step->numReads++] = command->words[i];
+        }
+        if(isWriterCommand(command))
+        {
+            for(i = 1; i < command->numWords && step->numWrites < MAX_COMMAND_LINE_ARGUMENTS; i++)
+            {
+                step->writes[step->numWrites++] = command->words[i];
+            }
+        }
+        for(i = 0; i < command->numRedirections; i++)
+        {
+            redirect = &command->redirections[i];
+            if(redirect->word != NULL && strchr(redirect->word, '$') != NULL)
+            {
+                step->isBarrier = true;
+            }
+            else if(redirect->type == REDIRECT_INPUT && step->numReads < MAX_COMMAND_LINE_ARGUMENTS)
+            {
+                step->reads[step->numReads++] = redirect->word;
+            }
+            else if((redirect->type == REDIRECT_OUTPUT || redirect->type == REDIRECT_APPEND) &&
+                step->numWrites < MAX_COMMAND_LINE_ARGUMENTS)
+            {
+                step->writes[step->numWrites++] = redirect->word;
+            }
+        }
+    }
+}
+
+/*
+*   Returns true if step and an earlier step must run in order: one
+*   writes a file the other reads or writes.
+*/
+bool stepsConflict(struct parallelStep* earlier, struct parallelStep* step)
+{
+    int i;
+
+    for(i = 0; i < earlier->numWrites; i++)
+    {
+        if(hasPath(step->reads, step->numReads, earlier->writes[i]) ||
+            hasPath(step->writes, step->numWrites, earlier->writes[i]))
+        {
+            return true;
+        }
+    }
+    for(i = 0; i < step->numWrites; i++)
+    {
+        if(hasPath(earlier->reads, earlier->numReads, step->writes[i]))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+*   Find the steps that step n depends on. A barrier depends on every
+*   step before it, and any step on the last barrier before it and on
+*   the steps after that barrier it conflicts with.
+*/
+void linkStep(struct parallelStep* steps, int n)
+{
+    int i;
+
+    steps[n].deps = malloc((n + 1) * sizeof(int));
+    for(i = n - 1; i >= 0; i--)
+    {
+        if(steps[n].isBarrier || steps[i].isBarrier || stepsConflict(&steps[i], &steps[n]))
+        {
+            steps[n].deps[steps[n].numDeps++] = i;
+        }
+        if(steps[i].isBarrier)
+        {
+            break;
+        }
+    }
+}
+
+/*
+*   Returns true if step is a line that is only "wait", a barrier
+*   that is not run.
+*/
+bool isWaitStep(struct parallelStep* step)
+{
+    return step->nodes->type == NODE_COMMAND && step->nodes->next == NULL &&
+        step->nodes->command->numWords == 1 && strcmp(step->nodes->command->words[0], "wait") == 0 &&
+        step->nodes->command->numRedirections == 0;
+}
+
+/*
+*   Returns true if every step that step depends on is done.
+*/
+bool isStepReady(struct parallelStep* steps, struct parallelStep* step)
+{
+    int i;
+
+    for(i = 0; i < step->numDeps; i++)
+    {
+        if(!steps[step->deps[i]].done)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+*   Start step in a worker child with stdin on /dev/null and stdout
+*   and stderr in memory files. Returns false if it could not be
+*   started, it is then done with status 1.
+*/
+bool startStep(struct shellContext* shell, struct parallelStep* step)
+{
+    int devNull;
+
+    step->outFD = moveToPlannedFD(memfd_create("smallsh-stdout", MFD_CLOEXEC));
+    step->errFD = moveToPlannedFD(memfd_create("smallsh-stderr", MFD_CLOEXEC));
+    fflush(stdout);
+    step->pid = step->outFD != -1 && step->errFD != -1 ? fork() : -1;
+    switch(step->pid)
+    {
+        case -1:
+            perror("fork() failed!");
+            fflush(stderr);
+            strcpy(step->status, "exit value 1");
+            step->done = true;
+            return false;
+        case 0:     // Child execution
+            devNull = open("/dev/null", O_RDONLY);
+            dup2(devNull, STDIN_FILENO);
+            close(devNull);
+            dup2(step->outFD, STDOUT_FILENO);
+            dup2(step->errFD, STDERR_FILENO);
+            resetChildShell(shell);
+
+            runNodeList(shell, step->nodes);
+            fflush(stdout);
+            fflush(stderr);
+            _exit(exitStatusCode(shell));
+        default:    // Parent execution
+            step->pidFD = syscall(SYS_pidfd_open, step->pid, 0);
+            return true;
+    }
+}
+
+/*
+*   Reap the worker of step and record its status.
+*/
+void finishStep(struct shellContext* shell, struct parallelStep* step)
+{
+    int childExitStatus;
+
+    waitForChild(shell, step->pid, &childExitStatus);
+    if(WIFEXITED(childExitStatus))
+    {
+        sprintf(step->status, "exit value %d", WEXITSTATUS(childExitStatus));
+    }
+    else
+    {
+        sprintf(step->status, "terminated by signal %d", WTERMSIG(childExitStatus));
+    }
+    if(step->pidFD != -1)
+    {
+        close(step->pidFD);
+    }
+    step->pid = -1;
+    step->pidFD = -1;
+    step->done = true;
+}
+
+/*
+*   Copy the output of step, done, to the shell's stdout and stderr
+*   and make its status the last status, as if it had just run.
+*/
+void replayStep(struct shellContext* shell, struct parallelStep* step)
+{
+    off_t offset = 0;
+
+    fflush(stdout);
+    if(step->outFD != -1)
+    {
+        copyFD(step->outFD, &offset, STDOUT_FILENO);
+        close(step->outFD);
+    }
+    offset = 0;
+    if(step->errFD != -1)
+    {
+        copyFD(step->errFD, &offset, STDERR_FILENO);
+        close(step->errFD);
+    }
+    step->outFD = -1;
+    step->errFD = -1;
+    strcpy(shell->exitStatus, step->status);
+}
+
+/*
+*   Read the steps of the script, one per line or per multi-line
+*   construct, into a malloc'd array. Returns the number read.
+*/
+int readParallelSteps(struct shellContext* shell, struct parallelStep** steps)
+{
+    struct hashTable definedNames = {0};
+    struct commandNode* nodes;
+    bool endOfInput = false;
+    int numSteps = 0;
+    int capacity = 0;
+
+    *steps = NULL;
+    while(!endOfInput)
+    {
+        nodes = getCommandLine(shell, &endOfInput);
+        if(nodes == NULL)
+        {
+            continue;
+        }
+        if(numSteps == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            *steps = realloc(*steps, capacity * sizeof(struct parallelStep));
+        }
+        memset(&(*steps)[numSteps], 0, sizeof(struct parallelStep));
+        (*steps)[numSteps].nodes = nodes;
+        (*steps)[numSteps].pid = -1;
+        (*steps)[numSteps].pidFD = -1;
+        (*steps)[numSteps].outFD = -1;
+        (*steps)[numSteps].errFD = -1;
+        analyzeStep(shell, &definedNames, &(*steps)[numSteps]);
+        addDefinedNames(&definedNames, &(*steps)[numSteps]);
+        linkStep(*steps, numSteps);
+        numSteps++;
+    }
+    freeDefinedNames(&definedNames);
+
+    return numSteps;
+}
+
+/*
+*   Runs smallsh --parallel [-j N] SCRIPT, args being the words after
+*   --parallel. Ready steps are started in script order while fewer
+*   than N run, and finished ones are replayed in order. A barrier
+*   runs in the shell when all before it are replayed, and exit stops
+*   the script there. Returns the status of the first step that
+*   failed, reported on stderr, or 0.
+*/
+int runParallelScript(struct shellContext* shell, int argc, char* argv[])
+{
+    struct parallelStep* steps;
+    struct parallelStep* step;
+    int waited[PARALLEL_WINDOW];
+    int running[PARALLEL_WINDOW];
+    long maxWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+    bool isExiting = false;
+    int firstFailure = -1;
+    int numReplayed = 0;
+    int numRunning = 0;
+    int numSteps;
+    int ready;
+    int code;
+    int i;
+
+    if(argc == 3 && strcmp(argv[0], "-j") == 0)
+    {
+        maxWorkers = atol(argv[1]);
+        argv += 2;
+        argc -= 2;
+    }
+    if(argc != 1 || maxWorkers < 1)
+    {
+        fprintf(stderr, "usage: smallsh --parallel [-j N] SCRIPT\n");
+        return 2;
+    }
+    if(maxWorkers > PARALLEL_WINDOW)
+    {
+        maxWorkers = PARALLEL_WINDOW;
+    }
+
+    shell->scriptFD = moveToPlannedFD(open(argv[0], O_RDONLY | O_CLOEXEC));
+    if(shell->scriptFD == -1)
+    {
+        fprintf(stderr, "smallsh: %s: %s\n", argv[0], strerror(errno));
+        return 127;
+    }
+    numSteps = readParallelSteps(shell, &steps);
+
+    while(numReplayed < numSteps && !isExiting)
+    {
+        // Start the steps that are ready, in order, within the window
+        for(i = numReplayed; i < numSteps && i < numReplayed + PARALLEL_WINDOW &&
+            numRunning < maxWorkers; i++)
+        {
+            step = &steps[i];
+            if(step->done || step->pid != -1 || step->isBarrier || !isStepReady(steps, step))
+            {
+                continue;
+            }
+            if(startStep(shell, step))
+            {
+                running[numRunning++] = i;
+            }
+        }
+
+        // Replay the steps done in order, and run a barrier that is next
+        while(numReplayed < numSteps && !isExiting && (steps[numReplayed].done ||
+            (steps[numReplayed].isBarrier && numRunning == 0)))
+        {
+            step = &steps[numReplayed];
+            if(isWaitStep(step))
+            {
+                strcpy(step->status, "exit value 0");
+                step->done = true;
+            }
+            else if(step->isBarrier)
+            {
+                isExiting = runNodeList(shell, step->nodes);
+                strcpy(step->status, shell->exitStatus);
+                step->done = true;
+                checkBGProcesses(shell);
+            }
+            else
+            {
+                replayStep(shell, step);
+            }
+            if(firstFailure == -1 && strcmp(step->status, "exit value 0") != 0)
+            {
+                firstFailure = numReplayed;
+            }
+            numReplayed++;
+        }
+
+        if(numRunning == 0)
+        {
+            continue;
+        }
+
+        // Wait for a worker to finish
+        for(i = 0; i < numRunning; i++)
+        {
+            waited[i] = steps[running[i]].pidFD;
+        }
+        ready = waitForEvents(shell, waited, numRunning);
+        for(i = 0; i < numRunning; i++)
+        {
+            step = &steps[running[i]];
+            if(ready == i || step->pidFD == -1)
+            {
+                finishStep(shell, step);
+                running[i--] = running[--numRunning];
+                ready = -1;
+            }
+        }
+    }
+
+    // After exit, workers still running are waited for
+    for(i = 0; i < numRunning; i++)
+    {
+        finishStep(shell, &steps[running[i]]);
+    }
+    for(i = 0; i < numSteps; i++)
+    {
+        if(steps[i].outFD != -1)
+        {
+            close(steps[i].outFD);
+            close(steps[i].errFD);
+        }
+        freeNodeList(steps[i].nodes);
+        free(steps[i].deps);
+    }
+    if(!isExiting)
+    {
+        runExitCommand(shell);
+    }
+
+    code = 0;
+    if(firstFailure != -1)
+    {
+        strcpy(shell->exitStatus, steps[firstFailure].status);
+        fprintf(stderr, "parallel: step %d failed: %s\n", firstFailure + 1, steps[firstFailure].status);
+        fflush(stderr);
+        code = exitStatusCode(shell);
+    }
+    free(steps);
+
+    return code;
+}
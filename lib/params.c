@@ -0,0 +1,480 @@
+/*
+*   Parameter expansion operators: ${#NAME}, ${NAME:-word},
+*   ${NAME-word}, ${NAME:offset:length}, ${NAME#pattern},
+*   ${NAME##pattern}, ${NAME%pattern}, ${NAME%%pattern},
+*   ${NAME/pattern/string} and ${NAME//pattern/string}, so a script
+*   edits file names in the shell instead of running basename,
+*   dirname, cut or sed. Patterns are globs with * ? [...] and \,
+*   compiled once and kept by their text in the shell's cache.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "smallsh.h"
+
+#define GLOB_CACHE_SIZE 1024    // compiled patterns kept, by text
+
+/* types of the parts of a compiled glob pattern */
+enum globPartType
+{
+    GLOB_LITERAL,       // one char
+    GLOB_ANY_CHAR,      // ?
+    GLOB_ANY_STRING,    // *
+    GLOB_CLASS          // [...] or [!...]
+};
+
+/* struct for a part of a compiled glob pattern */
+struct globPart
+{
+    enum globPartType type;
+    unsigned char literal;
+    unsigned char members[32];  // bitmap of the chars of a class
+};
+
+/* struct for a compiled glob pattern */
+struct globPattern
+{
+    struct globPart* parts;
+    int numParts;
+    bool isLiteral;     // no wildcards, matched with memcmp
+    char* text;         // the chars of a literal pattern
+    int length;
+};
+
+/*
+*   Free pattern.
+*/
+void freeGlobPattern(struct globPattern* pattern)
+{
+    free(pattern->parts);
+    free(pattern->text);
+    free(pattern);
+}
+
+/*
+*   Compile the bracket expression at text, after its [, into part.
+*   Returns pointer to the char after its ], or NULL if it has none,
+*   when the [ is a literal.
+*/
+const char* compileGlobClass(const char* text, struct globPart* part)
+{
+    bool negated = *text == '!' || *text == '^';
+    const char* c = negated ? text + 1 : text;
+    unsigned char first;
+    unsigned char last;
+    int i;
+
+    memset(part->members, 0, sizeof(part->members));
+    part->type = GLOB_CLASS;
+
+    // A ] first is a member
+    do
+    {
+        if(*c == 0)
+        {
+            return NULL;
+        }
+        first = *c == '\\' && c[1] != 0 ? *++c : *c;
+        last = first;
+        if(c[1] == '-' && c[2] != ']' && c[2] != 0)
+        {
+            c += 2;
+            last = *c == '\\' && c[1] != 0 ? *++c : *c;
+        }
+        for(i = first; i <= last; i++)
+        {
+            part->members[i / 8] |= 1 << (i % 8);
+        }
+        c++;
+    }
+    while(*c != ']');
+
+    if(negated)
+    {
+        for(i = 0; i < 32; i++)
+        {
+            part->members[i] = ~part->members[i];
+        }
+    }
+
+    return c + 1;
+}
+
+/*
+*   Compile the glob text into a pattern.
+*/
+struct globPattern* compileGlob(const char* text)
+{
+    struct globPattern* pattern = calloc(1, sizeof(struct globPattern));
+    struct globPart* part;
+    const char* next;
+    const char* c;
+
+    pattern->parts = malloc((strlen(text) + 1) * sizeof(struct globPart));
+    pattern->text = malloc(strlen(text) + 1);
+    pattern->isLiteral = true;
+    for(c = text; *c != 0; c++)
+    {
+        part = &pattern->parts[pattern->numParts++];
+        part->type = GLOB_LITERAL;
+        part->literal = *c;
+        if(*c == '\\' && c[1] != 0)
+        {
+            part->literal = *++c;
+        }
+        else if(*c == '?')
+        {
+            part->type = GLOB_ANY_CHAR;
+        }
+        else if(*c == '*')
+        {
+            part->type = GLOB_ANY_STRING;
+        }
+        else if(*c == '[' && (next = compileGlobClass(c + 1, part)) != NULL)
+        {
+            c = next - 1;
+        }
+        else
+        {
+            part->type = GLOB_LITERAL;
+        }
+
+        if(part->type == GLOB_LITERAL)
+        {
+            pattern->text[pattern->length++] = part->literal;
+        }
+        else
+        {
+            pattern->isLiteral = false;
+        }
+    }
+
+    return pattern;
+}
+
+/*
+*   Returns the compiled pattern of text, from the cache of shell or
+*   compiled and added to it. Once the cache is full a new pattern is
+*   not kept, and isCached is false for the caller to free it.
+*/
+struct globPattern* getGlobPattern(struct shellContext* shell, const char* text, bool* isCached)
+{
+    struct globPattern* pattern = hashLookup(&shell->globCache, text);
+
+    *isCached = true;
+    if(pattern == NULL)
+    {
+        pattern = compileGlob(text);
+        *isCached = shell->globCache.numEntries < GLOB_CACHE_SIZE;
+        if(*isCached)
+        {
+            hashInsert(&shell->globCache, text, pattern);
+        }
+    }
+
+    return pattern;
+}
+
+/*
+*   Returns true if part matches the char c.
+*/
+bool matchGlobPart(const struct globPart* part, unsigned char c)
+{
+    switch(part->type)
+    {
+        case GLOB_LITERAL:
+            return part->literal == c;
+        case GLOB_CLASS:
+            return (part->members[c / 8] >> (c % 8)) & 1;
+        default:
+            return true;
+    }
+}
+
+/*
+*   Returns true if pattern matches all len chars of text. On a
+*   mismatch after a * the match goes back to the last *, which then
+*   takes one more char.
+*/
+bool matchGlob(const struct globPattern* pattern, const char* text, int len)
+{
+    int star = -1;      // part after the last *
+    int starText = 0;   // text the last * took up to
+    int p = 0;
+    int t = 0;
+
+    if(pattern->isLiteral)
+    {
+        return len == pattern->length && memcmp(text, pattern->text, len) == 0;
+    }
+
+    while(t < len)
+    {
+        if(p < pattern->numParts && pattern->parts[p].type == GLOB_ANY_STRING)
+        {
+            star = ++p;
+            starText = t;
+        }
+        else if(p < pattern->numParts && matchGlobPart(&pattern->parts[p], text[t]))
+        {
+            p++;
+            t++;
+        }
+        else if(star != -1)
+        {
+            p = star;
+            t = ++starText;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while(p < pattern->numParts && pattern->parts[p].type == GLOB_ANY_STRING)
+    {
+        p++;
+    }
+
+    return p == pattern->numParts;
+}
+
+/*
+*   Returns the value of parameter name, a variable or positional
+*   argument 1 to 9, or NULL if it is not set.
+*/
+const char* getParameter(struct shellContext* shell, const char* name)
+{
+    if(name[0] >= '1' && name[0] <= '9' && name[1] == 0)
+    {
+        return name[0] - '1' < shell->numPositionalArgs ? shell->positionalArgs[name[0] - '1'] : NULL;
+    }
+
+    return getVariable(shell, name);
+}
+
+/*
+*   Returns value without the prefix or suffix pattern matches, by op
+*   # ## % or %%, as a malloc'd string.
+*/
+char* removeMatch(const char* value, const struct globPattern* pattern, const char* op)
+{
+    int len = strlen(value);
+    bool isLongest = op[1] == op[0];
+    int i;
+
+    for(i = 0; i <= len; i++)
+    {
+        if(op[0] == '#' && matchGlob(pattern, value, isLongest ? len - i : i))
+        {
+            return strdup(value + (isLongest ? len - i : i));
+        }
+        if(op[0] == '%' && matchGlob(pattern, value + (isLongest ? i : len - i), isLongest ? len - i : i))
+        {
+            return strndup(value, isLongest ? i : len - i);
+        }
+    }
+
+    return strdup(value);
+}
+
+/*
+*   Returns value with the longest match of pattern that starts first
+*   replaced by replacement, or every match if all, as a malloc'd
+*   string.
+*/
+char* replaceMatch(const char* value, const struct globPattern* pattern, const char* replacement, bool all)
+{
+    int replacementLen = strlen(replacement);
+    int len = strlen(value);
+    char* result = calloc(1, sizeof(char));
+    int resultLen = 0;
+    int start = 0;
+    int matchLen;
+    bool isReplaced = false;
+
+    while(start < len && pattern->numParts > 0 && (all || !isReplaced))
+    {
+        for(matchLen = len - start; matchLen > 0; matchLen--)
+        {
+            if(matchGlob(pattern, value + start, matchLen))
+            {
+                break;
+            }
+        }
+        if(matchLen > 0)
+        {
+            appendToField(&result, &resultLen, replacement, replacementLen);
+            start += matchLen;
+            isReplaced = true;
+        }
+        else
+        {
+            appendToField(&result, &resultLen, value + start, 1);
+            start++;
+        }
+    }
+    appendToField(&result, &resultLen, value + start, len - start);
+
+    return result;
+}
+
+/*
+*   Returns value from offset, for length chars if hasLength, as a
+*   malloc'd string. A negative offset counts from the end, and a
+*   negative length leaves that many chars off the end.
+*/
+char* substringOf(const char* value, long long offset, long long length, bool hasLength)
+{
+    long long len = strlen(value);
+    long long end;
+
+    if(offset < 0)
+    {
+        offset = offset < -len ? 0 : len + offset;
+    }
+    if(offset > len)
+    {
+        offset = len;
+    }
+    end = !hasLength ? len : length < 0 ? len + length : offset + length;
+    if(end > len)
+    {
+        end = len;
+    }
+
+    return strndup(value + offset, end > offset ? end - offset : 0);
+}
+
+/*
+*   Returns word with its variables and substitutions expanded, owned
+*   by fields, or word itself if it has none.
+*/
+const char* expandOperand(struct shellContext* shell, const char* word, struct wordList* fields)
+{
+    return strchr(word, '$') != NULL ? expandJoined(shell, word, fields) : word;
+}
+
+/*
+*   Split the offset and length of ${NAME:offset:length} at text and
+*   evaluate them as arithmetic. Returns false if one fails.
+*/
+bool parseSubstring(struct shellContext* shell, char* text, long long* offset, long long* length,
+    bool* hasLength)
+{
+    char* colon = strchr(text, ':');
+
+    *hasLength = colon != NULL;
+    if(colon != NULL)
+    {
+        *colon = 0;
+    }
+
+    return evaluateArithmetic(shell, text[strspn(text, " ")] != 0 ? text : "0", offset) &&
+        (colon == NULL || evaluateArithmetic(shell, colon + 1, length));
+}
+
+/*
+*   Expand the parameter expression inner of ${inner}. Returns the
+*   malloc'd text, or NULL after printing an error, when the
+*   expression is not one of the operators or its arithmetic fails.
+*/
+char* expandParameter(struct shellContext* shell, const char* inner, struct wordList* fields)
+{
+    struct globPattern* pattern;
+    const char* operand;
+    const char* value;
+    const char* op;
+    char* result = NULL;
+    char* name;
+    char* text;
+    char* slash;
+    bool isLength = inner[0] == '#' && inner[1] != 0;
+    bool isCached;
+    bool hasLength;
+    long long offset;
+    long long length;
+    int nameLen;
+
+    nameLen = (inner[isLength] >= '1' && inner[isLength] <= '9') ? 1 : variableNameLength(inner + isLength);
+    if(nameLen == 0 || (isLength && inner[1 + nameLen] != 0))
+    {
+        fprintf(stderr, "smallsh: ${%s}: bad substitution\n", inner);
+        fflush(stderr);
+        return NULL;
+    }
+    name = strndup(inner + isLength, nameLen);
+    value = getParameter(shell, name);
+    free(name);
+    op = inner + isLength + nameLen;
+
+    if(isLength)
+    {
+        result = malloc(32);
+        sprintf(result, "%zu", value != NULL ? strlen(value) : 0);
+    }
+    else if(*op == 0)
+    {
+        result = strdup(value != NULL ? value : "");
+    }
+    else if(strncmp(op, ":-", 2) == 0 || *op == '-')
+    {
+        // Default if unset, or with : also if empty
+        if(value == NULL || (*op == ':' && *value == 0))
+        {
+            value = expandOperand(shell, op + (*op == ':' ? 2 : 1), fields);
+        }
+        result = strdup(value);
+    }
+    else if(*op == ':')
+    {
+        text = strdup(expandOperand(shell, op + 1, fields));
+        if(parseSubstring(shell, text, &offset, &length, &hasLength))
+        {
+            result = substringOf(value != NULL ? value : "", offset, length, hasLength);
+        }
+        free(text);
+    }
+    else if(*op == '#' || *op == '%' || *op == '/')
+    {
+        // Pattern after the op, and for / the string after the next
+        // / that is not escaped
+        text = strdup(op + (op[1] == op[0] ? 2 : 1));
+        slash = NULL;
+        if(*op == '/')
+        {
+            for(slash = text; *slash != 0 && *slash != '/'; slash++)
+            {
+                slash += *slash == '\\' && slash[1] != 0;
+            }
+            if(*slash == '/')
+            {
+                *slash++ = 0;
+            }
+        }
+
+        pattern = getGlobPattern(shell, expandOperand(shell, text, fields), &isCached);
+        if(*op == '/')
+        {
+            operand = expandOperand(shell, slash, fields);
+            result = replaceMatch(value != NULL ? value : "", pattern, operand, op[1] == '/');
+        }
+        else
+        {
+            result = removeMatch(value != NULL ? value : "", pattern, op);
+        }
+        if(!isCached)
+        {
+            freeGlobPattern(pattern);
+        }
+        free(text);
+    }
+    else
+    {
+        fprintf(stderr, "smallsh: ${%s}: bad substitution\n", inner);
+        fflush(stderr);
+    }
+
+    return result;
+}
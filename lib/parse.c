@@ -0,0 +1,1078 @@
+/*
+*   Parsing command lines into command structures and lists of nodes
+*   for loops and function definitions.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "smallsh.h"
+
+/*
+*   Program that sets in struct if command will run in foreground or
+*   background. This is determined by the '&' character, which, if it
+*   appears at the end of the commandLine, then the command will run
+*   in the background. Otherwise, command will run in the foreground.
+*   Struct bool values for fg and bg are set accordingly.
+*   Special case if the shell is in foreground-only mode, then fg is true.
+*/
+void setCommandPosition(struct shellContext* shell, char* commandLine, struct commandElements* curCommand)
+{
+    if(commandLine[strlen(commandLine) - 1] == '&')
+    {
+        if(shell->foregroundOnly == false)
+        {
+            curCommand->fg = false;
+            curCommand->bg = true;
+        }
+        else
+        {
+            curCommand->fg = true;
+            curCommand->bg = false;
+        }
+        // Overwrite '&' as it has already been used to determine
+        // command position
+        commandLine[strlen(commandLine) - 1] = 0;
+    }
+    else
+    {
+        // printf("& is at midline\n");
+        curCommand->fg = true;
+        curCommand->bg = false;
+    }
+}
+
+/*
+*   Save the delimiter of a here-document, without quotes. If the
+*   delimiter was quoted the body is used as is, otherwise $$ in the
+*   body is expanded.
+*/
+void setHereDelimiter(struct commandElements* curCommand, char* word)
+{
+    int len = strlen(word);
+
+    curCommand->hereQuoted = false;
+    if(len >= 2 && (word[0] == '\'' || word[0] == '"') && word[len - 1] == word[0])
+    {
+        curCommand->hereQuoted = true;
+        word[len - 1] = 0;
+        word++;
+    }
+
+    curCommand->hereDelimiter = strdup(word);
+}
+
+/*
+*   Add a redirection to curCommand. Later redirections past
+*   MAX_REDIRECTIONS are dropped.
+*/
+void addRedirection(struct commandElements* curCommand, enum redirectType type, int fd,
+    int sourceFD, const char* word)
+{
+    struct redirection* redirect;
+
+    if(curCommand->numRedirections == MAX_REDIRECTIONS)
+    {
+        return;
+    }
+
+    redirect = &curCommand->redirections[curCommand->numRedirections++];
+    redirect->type = type;
+    redirect->fd = fd;
+    redirect->sourceFD = sourceFD;
+    redirect->word = word != NULL ? strdup(word) : NULL;
+}
+
+/*
+*   If token is a redirection, add it to curCommand and return true.
+*   Handles [N]<file, [N]>file, [N]>>file, [N]>&M, [N]<&M, [N]>&-,
+*   &>file, &>>file, << here-documents and <<< here-strings. The file
+*   or fd may be in the token or the next word read from cursor.
+*/
+bool parseRedirection(struct commandElements* curCommand, char* token, char** cursor)
+{
+    enum redirectType type;
+    char* op = token + strspn(token, "0123456789");
+    char* word;
+    bool bothOutputs = false;
+    int fd;
+
+    if(op == token && strncmp(token, "&>", 2) == 0)
+    {
+        bothOutputs = true;
+        op++;
+    }
+    if((*op != '<' && *op != '>') || (op == token && op[1] == '('))
+    {
+        // <( ... ) and >( ... ) are process substitutions
+        return false;
+    }
+    fd = op != token && !bothOutputs ? atoi(token) : (*op == '<' ? 0 : 1);
+
+    if(strncmp(op, "<<<", 3) == 0)
+    {
+        // Here-string, word and a newline are the input
+        word = op[3] != 0 ? op + 3 : nextWord(cursor);
+        free(curCommand->hereStringWord);
+        curCommand->hereStringWord = strdup(word ? word : "");
+        addRedirection(curCommand, REDIRECT_HERE, fd, -1, NULL);
+        return true;
+    }
+    if(strncmp(op, "<<", 2) == 0)
+    {
+        // Here-document, body is read after the line
+        word = op[2] != 0 ? op + 2 : nextWord(cursor);
+        free(curCommand->hereDelimiter);
+        setHereDelimiter(curCommand, word ? word : "");
+        addRedirection(curCommand, REDIRECT_HERE, fd, -1, NULL);
+        return true;
+    }
+
+    type = *op == '<' ? REDIRECT_INPUT : REDIRECT_OUTPUT;
+    op++;
+    if(type == REDIRECT_OUTPUT && *op == '>')
+    {
+        type = REDIRECT_APPEND;
+        op++;
+    }
+
+    if(*op == '&' && !bothOutputs && type != REDIRECT_APPEND)
+    {
+        word = op[1] != 0 ? op + 1 : nextWord(cursor);
+        if(word != NULL && strcmp(word, "-") == 0)
+        {
+            addRedirection(curCommand, REDIRECT_CLOSE, fd, -1, NULL);
+            return true;
+        }
+        if(word != NULL && word[0] != 0 && word[strspn(word, "0123456789")] == 0)
+        {
+            addRedirection(curCommand, REDIRECT_DUP, fd, atoi(word), NULL);
+            return true;
+        }
+        // >&file is the same as &>file
+        bothOutputs = type == REDIRECT_OUTPUT;
+    }
+    else
+    {
+        word = *op != 0 ? op : nextWord(cursor);
+    }
+
+    addRedirection(curCommand, type, fd, -1, word ? word : "");
+    if(bothOutputs)
+    {
+        addRedirection(curCommand, REDIRECT_DUP, 2, 1, NULL);
+    }
+    return true;
+}
+
+/*
+*   Parses command line into elements in commandElements struct.
+*/
+struct commandElements* parseCommandLine(struct shellContext* shell, char* commandLine)
+{
+    struct commandElements *curCommand = calloc(1, sizeof(struct commandElements));
+
+    curCommand->hereFD = -1;
+    curCommand->inputFD = -1;
+    curCommand->logFD = -1;
+    curCommand->execStatusFD = -1;
+
+    // Check if command line is a blank line or is a comment that
+    // starts with '#'
+    if(commandLine[0] == 0 || commandLine[0] == '#')
+    {
+        curCommand->ignore = true;
+        return curCommand;  // return immediately as no other info needed
+    }
+    else
+    {
+        curCommand->ignore = false;
+    }
+
+    // Set if command will run in foreground or background
+    setCommandPosition(shell, commandLine, curCommand);
+
+    // Parse command into words, $( ... ) is kept as one word. Words
+    // are kept as they are and expanded when the command is run.
+    char* cursor = commandLine;
+    char* token = nextWord(&cursor);
+    int index = 0;
+
+    // Go through command line until all arguments parsed, taking
+    // redirections out
+    while(token != NULL)
+    {
+        if(parseRedirection(curCommand, token, &cursor))
+        {
+            // Redirections can come anywhere
+        }
+        else if(index == 0 && curCommand->numAssignments < MAX_ASSIGNMENTS && isAssignmentWord(token))
+        {
+            curCommand->assignments[curCommand->numAssignments++] = strdup(token);
+        }
+        else if(index < MAX_COMMAND_LINE_ARGUMENTS - 1)
+        {
+            curCommand->words[index++] = strdup(token);
+        }
+        token = nextWord(&cursor);
+    }
+
+    curCommand->numWords = index;
+    curCommand->isAssignment = index == 0 && curCommand->numAssignments > 0 &&
+        curCommand->numRedirections == 0;
+
+    if(index == 0 && curCommand->numAssignments == 0 && curCommand->numRedirections == 0)
+    {
+        curCommand->ignore = true;
+    }
+
+    return curCommand;
+}
+
+/*
+*   Free a parsed command and everything it owns.
+*/
+void freeCommand(struct commandElements* curCommand)
+{
+    int i;
+
+    releaseExpansion(curCommand);
+    free(curCommand->expansion.words);
+    free(curCommand->expansion.buffers);
+    free(curCommand->expansion.fds);
+
+    for(i = 0; i < curCommand->numWords; i++)
+    {
+        free(curCommand->words[i]);
+    }
+    for(i = 0; i < curCommand->numAssignments; i++)
+    {
+        free(curCommand->assignments[i]);
+    }
+    for(i = 0; i < curCommand->numRedirections; i++)
+    {
+        free(curCommand->redirections[i].word);
+    }
+    free(curCommand->hereStringWord);
+    free(curCommand->hereDelimiter);
+    free(curCommand->hereBody);
+
+    if(curCommand->hereFD != -1)
+    {
+        close(curCommand->hereFD);
+    }
+
+    free(curCommand);
+}
+
+/*
+*   Read the body of a here-document, the lines after the command
+*   line up to a line with only the delimiter, into a sealed memory
+*   file used as input of curCommand on every run.
+*/
+void readHereDocument(struct shellContext* shell, struct commandElements* curCommand)
+{
+    char* line = calloc(MAX_COMMAND_LINE_LENGTH, sizeof(char));
+    char* body = NULL;
+    char* expanded;
+    int bodyLen = 0;
+
+    while(true)
+    {
+        if(isatty(shell->scriptFD))
+        {
+            printf("> ");
+            fflush(stdout);
+        }
+        if(!readCommandLine(shell, line, MAX_COMMAND_LINE_LENGTH))
+        {
+            break;  // End of file also ends the here-document
+        }
+        line[strcspn(line, "\n")] = 0;
+
+        if(strcmp(line, curCommand->hereDelimiter) == 0)
+        {
+            break;
+        }
+
+        expanded = curCommand->hereQuoted ? line : replaceString(line);
+        appendToField(&body, &bodyLen, expanded, strlen(expanded));
+        appendToField(&body, &bodyLen, "\n", 1);
+        if(expanded != line)
+        {
+            free(expanded);
+        }
+    }
+
+    // Body without a $ left after $$ is expanded never changes
+    curCommand->hereBody = body ? body : calloc(1, sizeof(char));
+    if(curCommand->hereQuoted || strchr(curCommand->hereBody, '$') == NULL)
+    {
+        curCommand->hereFD = createSealedInput(curCommand->hereBody, bodyLen);
+    }
+    free(line);
+    free(curCommand->hereDelimiter);
+    curCommand->hereDelimiter = NULL;
+}
+
+/*
+*   struct for reading the ';', '&&' and '||' separated segments of a
+*   command line, and more lines when a loop or list is not finished
+*   at the end of a line.
+*/
+struct lineReader
+{
+    char* cursor;       // start of the next segment
+    enum listConnector connector;       // before the last segment
+    enum listConnector nextConnector;   // after the last segment
+    char** lines;       // lines read, freed when parsing is done
+    int numLines;
+    bool canReadMore;   // false if only the first line may be used
+    bool error;         // set on a syntax error
+    int subshellDepth;  // ( subshells open, a ) ends a segment in one
+    bool closePending;  // the last segment ended at a ')'
+    bool afterClose;    // the last segment is what follows a ')'
+};
+
+/*
+*   Read another line for the reader from stdin, with $$ expanded.
+*   Returns false at end of file or if the reader can not read more.
+*/
+bool readContinuationLine(struct shellContext* shell, struct lineReader* reader)
+{
+    char* line;
+    char* expanded;
+
+    if(!reader->canReadMore)
+    {
+        return false;
+    }
+
+    if(isatty(shell->scriptFD))
+    {
+        printf("> ");
+        fflush(stdout);
+    }
+
+    line = calloc(MAX_COMMAND_LINE_LENGTH, sizeof(char));
+    if(!readCommandLine(shell, line, MAX_COMMAND_LINE_LENGTH))
+    {
+        free(line);
+        return false;
+    }
+    line[strcspn(line, "\n")] = 0;
+
+    expanded = replaceString(line);
+    if(expanded != line)
+    {
+        free(line);
+        line = expanded;
+    }
+
+    reader->lines = realloc(reader->lines, (reader->numLines + 1) * sizeof(char*));
+    reader->lines[reader->numLines++] = line;
+    reader->cursor = line;
+
+    return true;
+}
+
+/*
+*   Returns true if only spaces are left on the reader's line.
+*/
+bool atLineEnd(struct lineReader* reader)
+{
+    return reader->cursor[strspn(reader->cursor, " ")] == 0;
+}
+
+/*
+*   Print a syntax error and mark the reader so parsing stops.
+*/
+void syntaxError(struct lineReader* reader, const char* message)
+{
+    if(!reader->error)
+    {
+        fprintf(stderr, "smallsh: syntax error: %s\n", message);
+        fflush(stderr);
+    }
+    reader->error = true;
+}
+
+/*
+*   Returns true if the first word of text is keyword, and sets *rest
+*   to the text after it.
+*/
+bool startsWithKeyword(char* text, const char* keyword, char** rest)
+{
+    int len = strlen(keyword);
+
+    text += strspn(text, " ");
+    if(strncmp(text, keyword, len) == 0 && (text[len] == 0 || text[len] == ' '))
+    {
+        *rest = text + len;
+        return true;
+    }
+
+    return false;
+}
+
+/*
+*   Get the next segment of the command line, which ends at a ';',
+*   '&&' or '||' that is not in quotes or a $( ... ), or at the end of
+*   the line. In a ( subshell a ')' also ends it, and the text after
+*   the ')' is the next segment, marked by reader->afterClose.
+*   The operator before the segment is left in reader->connector. If
+*   the line is used up another line is read. The segment is
+*   terminated in place, without spaces around it. Returns NULL at end
+*   of input.
+*/
+char* nextSegment(struct shellContext* shell, struct lineReader* reader)
+{
+    char* segment;
+    char* end;
+    char quote = 0;
+    int depth = 0;
+
+    // Text after a ')' at the end of the line is an empty segment
+    while(!reader->closePending && atLineEnd(reader))
+    {
+        if(!readContinuationLine(shell, reader))
+        {
+            return NULL;
+        }
+    }
+
+    segment = reader->cursor + strspn(reader->cursor, " ");
+    reader->connector = reader->nextConnector;
+    reader->nextConnector = LIST_ALWAYS;
+    reader->afterClose = reader->closePending;
+    reader->closePending = false;
+    if(reader->afterClose)
+    {
+        reader->subshellDepth--;
+    }
+
+    // Each ( a segment starts with, after any keywords that start a
+    // list, opens a subshell. A ( later in a command is text.
+    end = segment;
+    while(startsWithKeyword(end, "do", &end) || startsWithKeyword(end, "while", &end) ||
+        startsWithKeyword(end, "{", &end) || end[strspn(end, " ")] == '(')
+    {
+        end += strspn(end, " ");
+        if(*end == '(')
+        {
+            reader->subshellDepth++;
+            end++;
+        }
+    }
+
+    // A comment uses up the rest of the line
+    if(segment[0] == '#')
+    {
+        reader->cursor = segment + strlen(segment);
+        return reader->cursor;
+    }
+
+    for(end = segment; *end != 0; end++)
+    {
+        // Operators in quotes are text, as in an alias body
+        if((*end == '\'' || *end == '"') && (quote == 0 || quote == *end))
+        {
+            quote = quote == 0 ? *end : 0;
+            continue;
+        }
+        if(quote != 0)
+        {
+            continue;
+        }
+        if(depth == 0 && (*end == ';' || strncmp(end, "&&", 2) == 0 || strncmp(end, "||", 2) == 0))
+        {
+            break;
+        }
+        if(depth == 0 && *end == ')' && reader->subshellDepth > 0)
+        {
+            reader->closePending = true;
+            break;
+        }
+        if(((end[0] == '$' || end[0] == '<' || end[0] == '>') && end[1] == '(') ||
+            (end[0] == '$' && end[1] == '{'))
+        {
+            depth++;
+            end++;
+        }
+        else if(*end == '(' && depth > 0)
+        {
+            depth++;
+        }
+        else if((*end == ')' || *end == '}') && depth > 0)
+        {
+            depth--;
+        }
+    }
+
+    if(*end == '&' || *end == '|')
+    {
+        reader->nextConnector = *end == '&' ? LIST_AND : LIST_OR;
+        if(end == segment && !reader->afterClose)
+        {
+            syntaxError(reader, *end == '&' ? "unexpected '&&'" : "unexpected '||'");
+        }
+        *end++ = 0;
+    }
+
+    reader->cursor = *end != 0 ? end + 1 : end;
+    *end = 0;
+    while(end > segment && (end[-1] == ' ' || end[-1] == 0))
+    {
+        *--end = 0;
+    }
+
+    return segment;
+}
+
+/*
+*   Free a list of nodes and everything they own.
+*/
+void freeNodeList(struct commandNode* node)
+{
+    struct commandNode* next;
+    int i;
+
+    while(node != NULL)
+    {
+        next = node->next;
+        if(node->command != NULL)
+        {
+            freeCommand(node->command);
+        }
+        for(i = 0; i < node->numLoopWords; i++)
+        {
+            free(node->loopWords[i]);
+        }
+        free(node->loopWords);
+        free(node->variable);
+        freeNodeList(node->condition);
+        freeNodeList(node->body);
+        free(node);
+        node = next;
+    }
+}
+
+struct commandNode* parseStatement(struct shellContext* shell, char* segment, struct lineReader* reader);
+
+/*
+*   Parse segments into a list of nodes until a segment that starts
+*   with terminator, "do", "done" or "}", or for ")" the segment after
+*   a ')'. The text after the terminator is returned in *rest. The
+*   first segment is given, the others are read from reader.
+*/
+struct commandNode* parseList(struct shellContext* shell, char* segment, struct lineReader* reader,
+    const char* terminator, char** rest)
+{
+    struct commandNode* head = NULL;
+    struct commandNode* tail = NULL;
+    struct commandNode* node;
+    enum listConnector connector;
+    char message[256];
+
+    while(!reader->error)
+    {
+        if(segment == NULL)
+        {
+            sprintf(message, "unexpected end of file, expecting '%s'", terminator);
+            syntaxError(reader, message);
+            break;
+        }
+
+        if(strcmp(terminator, ")") == 0 ? reader->afterClose : startsWithKeyword(segment, terminator, rest))
+        {
+            if(reader->afterClose)
+            {
+                *rest = segment;
+                reader->afterClose = false;
+            }
+            return head;
+        }
+        connector = head == NULL ? LIST_ALWAYS : reader->connector;
+
+        node = parseStatement(shell, segment, reader);
+        if(node != NULL)
+        {
+            node->connector = connector;
+            if(tail == NULL)
+            {
+                head = node;
+            }
+            else
+            {
+                tail->next = node;
+            }
+            tail = node;
+        }
+        else if(reader->error)
+        {
+            // No more lines are read after an error
+            break;
+        }
+
+        segment = nextSegment(shell, reader);
+    }
+
+    freeNodeList(head);
+    return NULL;
+}
+
+/*
+*   Parse "for NAME in WORDS; do LIST; done". Text is what follows
+*   "for". The words are kept as parsed and expanded each time the
+*   loop starts.
+*/
+struct commandNode* parseForLoop(struct shellContext* shell, char* text, struct lineReader* reader)
+{
+    struct commandNode* node = calloc(1, sizeof(struct commandNode));
+    char* cursor = text;
+    char* word = nextWord(&cursor);
+    char* rest;
+
+    node->type = NODE_FOR;
+
+    if(word == NULL || variableNameLength(word) != (int)strlen(word))
+    {
+        syntaxError(reader, "bad for loop variable");
+        free(node);
+        return NULL;
+    }
+    node->variable = strdup(word);
+
+    word = nextWord(&cursor);
+    if(word != NULL && strcmp(word, "in") != 0)
+    {
+        syntaxError(reader, "expecting 'in' in for loop");
+        freeNodeList(node);
+        return NULL;
+    }
+
+    while((word = nextWord(&cursor)) != NULL)
+    {
+        node->loopWords = realloc(node->loopWords, (node->numLoopWords + 1) * sizeof(char*));
+        node->loopWords[node->numLoopWords++] = strdup(word);
+    }
+
+    // Nothing may come between the words and "do"
+    if(parseList(shell, nextSegment(shell, reader), reader, "do", &rest) != NULL)
+    {
+        syntaxError(reader, "expecting 'do' in for loop");
+    }
+    if(!reader->error)
+    {
+        node->body = parseList(shell, rest, reader, "done", &rest);
+    }
+    if(!reader->error && rest[strspn(rest, " ")] != 0)
+    {
+        syntaxError(reader, "unexpected text after 'done'");
+    }
+
+    if(reader->error)
+    {
+        freeNodeList(node);
+        return NULL;
+    }
+
+    return node;
+}
+
+/*
+*   Parse "while LIST; do LIST; done". Text is what follows "while".
+*/
+struct commandNode* parseWhileLoop(struct shellContext* shell, char* text, struct lineReader* reader)
+{
+    struct commandNode* node = calloc(1, sizeof(struct commandNode));
+    char* rest;
+
+    node->type = NODE_WHILE;
+    node->condition = parseList(shell, text, reader, "do", &rest);
+    if(!reader->error && node->condition == NULL)
+    {
+        syntaxError(reader, "missing while loop condition");
+    }
+    if(!reader->error)
+    {
+        node->body = parseList(shell, rest, reader, "done", &rest);
+    }
+    if(!reader->error && rest[strspn(rest, " ")] != 0)
+    {
+        syntaxError(reader, "unexpected text after 'done'");
+    }
+
+    if(reader->error)
+    {
+        freeNodeList(node);
+        return NULL;
+    }
+
+    return node;
+}
+
+/*
+*   Returns length of the function name if text starts a function
+*   definition, "NAME() {" or "NAME () {", and sets *rest to the text
+*   after the '{'. Returns 0 otherwise.
+*/
+int functionDefinitionLength(char* text, char** rest)
+{
+    char* start = text + strspn(text, " ");
+    int len = variableNameLength(start);
+    char* after = start + len;
+
+    after += strspn(after, " ");
+    if(len == 0 || strncmp(after, "()", 2) != 0 || !startsWithKeyword(after + 2, "{", rest))
+    {
+        return 0;
+    }
+
+    return len;
+}
+
+/*
+*   Parse "NAME() { LIST; }". The body is parsed here once and stored
+*   when the definition is run.
+*/
+struct commandNode* parseFunction(struct shellContext* shell, char* segment, int nameLen, char* rest,
+    struct lineReader* reader)
+{
+    struct commandNode* node = calloc(1, sizeof(struct commandNode));
+    char* name = segment + strspn(segment, " ");
+
+    node->type = NODE_FUNCTION;
+    node->variable = strndup(name, nameLen);
+    node->body = parseList(shell, rest, reader, "}", &rest);
+    if(!reader->error && rest[strspn(rest, " ")] != 0)
+    {
+        syntaxError(reader, "unexpected text after '}'");
+    }
+
+    if(reader->error)
+    {
+        freeNodeList(node);
+        return NULL;
+    }
+
+    return node;
+}
+
+/*
+*   Parse a "{ LIST; }" group or a "( LIST )" subshell. Text is what
+*   follows the '{' or '('. Redirections and a '&' after the closing
+*   '}' or ')' are for the whole list, they are kept in the node's
+*   command, which has no words.
+*/
+struct commandNode* parseGroup(struct shellContext* shell, char* text, struct lineReader* reader,
+    enum nodeType type)
+{
+    struct commandNode* node = calloc(1, sizeof(struct commandNode));
+    const char* terminator = type == NODE_GROUP ? "}" : ")";
+    char message[256];
+    char* rest;
+
+    node->type = type;
+    node->body = parseList(shell, text, reader, terminator, &rest);
+    if(reader->error)
+    {
+        freeNodeList(node);
+        return NULL;
+    }
+
+    rest += strspn(rest, " ");
+    node->command = parseCommandLine(shell, rest);
+    if(node->command->numWords > 0)
+    {
+        sprintf(message, "unexpected text after '%s'", terminator);
+        syntaxError(reader, message);
+        freeNodeList(node);
+        return NULL;
+    }
+    if(!node->command->bg)
+    {
+        node->command->fg = true;
+    }
+
+    if(node->command->hereDelimiter != NULL)
+    {
+        if(reader->canReadMore)
+        {
+            readHereDocument(shell, node->command);
+        }
+        else
+        {
+            node->command->hereFD = createSealedInput("", 0);
+        }
+    }
+
+    return node;
+}
+
+/*
+*   Parse one statement, a loop, a function definition or a command.
+*   Returns NULL for a blank line or comment, or on a syntax error.
+*/
+struct commandNode* parseStatement(struct shellContext* shell, char* segment, struct lineReader* reader)
+{
+    struct commandNode* node;
+    char* rest;
+    int nameLen;
+
+    if(startsWithKeyword(segment, "for", &rest))
+    {
+        return parseForLoop(shell, rest, reader);
+    }
+    if(startsWithKeyword(segment, "while", &rest))
+    {
+        return parseWhileLoop(shell, rest, reader);
+    }
+    if((nameLen = functionDefinitionLength(segment, &rest)) > 0)
+    {
+        return parseFunction(shell, segment, nameLen, rest, reader);
+    }
+    if(startsWithKeyword(segment, "{", &rest))
+    {
+        return parseGroup(shell, rest, reader, NODE_GROUP);
+    }
+    if(segment[strspn(segment, " ")] == '(')
+    {
+        return parseGroup(shell, segment + strspn(segment, " ") + 1, reader, NODE_SUBSHELL);
+    }
+    if(startsWithKeyword(segment, "do", &rest) || startsWithKeyword(segment, "done", &rest) ||
+        startsWithKeyword(segment, "}", &rest))
+    {
+        syntaxError(reader, "unexpected 'do', 'done' or '}'");
+        return NULL;
+    }
+    if(reader->afterClose)
+    {
+        syntaxError(reader, "unexpected ')'");
+        return NULL;
+    }
+
+    node = calloc(1, sizeof(struct commandNode));
+    node->type = NODE_COMMAND;
+    node->command = parseCommandLine(shell, segment + strspn(segment, " "));
+
+    // A here-document body follows the line of its command
+    if(node->command->hereDelimiter != NULL)
+    {
+        if(reader->canReadMore)
+        {
+            readHereDocument(shell, node->command);
+        }
+        else
+        {
+            node->command->hereFD = createSealedInput("", 0);
+        }
+    }
+
+    if(node->command->ignore)
+    {
+        freeNodeList(node);
+        return NULL;
+    }
+
+    return node;
+}
+
+/*
+*   If the last node of the list is a background command or group
+*   joined by && or ||, the & is for the whole && || list it ends.
+*   That list is moved into a NODE_BACKGROUND node run in one
+*   background child, and its commands are run in the foreground
+*   there. Returns the head of the list.
+*/
+struct commandNode* wrapBackgroundList(struct commandNode* head)
+{
+    struct commandNode* beforeStart = NULL;
+    struct commandNode* start = head;
+    struct commandNode* last = head;
+    struct commandNode* node;
+
+    for(node = head; node != NULL && node->next != NULL; node = node->next)
+    {
+        if(node->next->connector == LIST_ALWAYS)
+        {
+            beforeStart = node;
+            start = node->next;
+        }
+        last = node->next;
+    }
+
+    if(last == NULL || last == start || last->command == NULL || !last->command->bg)
+    {
+        return head;
+    }
+
+    last->command->fg = true;
+    last->command->bg = false;
+
+    node = calloc(1, sizeof(struct commandNode));
+    node->type = NODE_BACKGROUND;
+    node->connector = start->connector;
+    node->body = start;
+    start->connector = LIST_ALWAYS;
+
+    // The child's stdin and stdout are planned like those of a
+    // background command with no words
+    node->command = calloc(1, sizeof(struct commandElements));
+    node->command->hereFD = -1;
+    node->command->inputFD = -1;
+    node->command->logFD = -1;
+    node->command->execStatusFD = -1;
+    node->command->bg = true;
+
+    if(beforeStart == NULL)
+    {
+        return node;
+    }
+    beforeStart->next = node;
+    return head;
+}
+
+/*
+*   Parse a command line into a list of nodes. The line is split into
+*   ';', '&&' and '||' separated statements, and more lines are read
+*   if canReadMore until a loop, function or list is finished. Returns
+*   NULL if there is nothing to run.
+*/
+struct commandNode* parseLine(struct shellContext* shell, char* line, bool canReadMore)
+{
+    struct lineReader reader = {0};
+    struct commandNode* head = NULL;
+    struct commandNode* tail = NULL;
+    struct commandNode* node;
+    enum listConnector connector;
+    char* segment;
+    int i;
+
+    reader.cursor = line;
+    reader.canReadMore = canReadMore;
+
+    while(!reader.error && (!atLineEnd(&reader) || reader.nextConnector != LIST_ALWAYS))
+    {
+        segment = nextSegment(shell, &reader);
+        if(segment == NULL)
+        {
+            syntaxError(&reader, "unexpected end of file after '&&' or '||'");
+            break;
+        }
+
+        connector = head == NULL ? LIST_ALWAYS : reader.connector;
+        node = parseStatement(shell, segment, &reader);
+        if(node == NULL)
+        {
+            continue;
+        }
+        node->connector = connector;
+        if(tail == NULL)
+        {
+            head = node;
+        }
+        else
+        {
+            tail->next = node;
+        }
+        tail = node;
+    }
+    head = wrapBackgroundList(head);
+
+    if(reader.error)
+    {
+        freeNodeList(head);
+        head = NULL;
+        strcpy(shell->exitStatus, "exit value 2");
+    }
+
+    for(i = 0; i < reader.numLines; i++)
+    {
+        free(reader.lines[i]);
+    }
+    free(reader.lines);
+
+    return head;
+}
+
+/*
+*   Get command line and parse it into a list of nodes. Sets
+*   *endOfInput at end of file. Returns NULL if there is nothing to
+*   run.
+*/
+struct commandNode* getCommandLine(struct shellContext* shell, bool* endOfInput)
+{
+    struct commandNode* curNode;
+    char* commandLine = calloc(MAX_COMMAND_LINE_LENGTH, sizeof(char));
+
+    // Print shell prompt character, except to server clients and for
+    // the text of -c
+    if(!shell->serving && shell->scriptFD == STDIN_FILENO)
+    {
+        printf(": ");
+        fflush(stdout);
+    }
+
+    // Get command line until a newline is read, with line editing
+    // and tab completion when reading from a terminal
+    *endOfInput = !readCommandLine(shell, commandLine, MAX_COMMAND_LINE_LENGTH);
+
+    // Get index of newline char and overwrite it with 0
+    commandLine[strcspn(commandLine, "\n")] = 0;
+
+    // Pass copy of commandLine to be replaced if it's not null
+    char* tempLine = calloc(MAX_COMMAND_LINE_LENGTH, sizeof(char));
+    
+    if(commandLine[0] != 0)
+    {
+        strcpy(tempLine, commandLine);
+        strcpy(commandLine, replaceString(tempLine));
+    }
+    
+    free(tempLine);
+
+    // Parse command line, and any lines needed to finish a loop
+    curNode = parseLine(shell, commandLine, true);
+    free(commandLine);
+
+    return curNode;
+}
+
+/*
+*   Print data for the commandElements struct. For testing purposes.
+*/
+void printCommandElements(struct commandElements* curCommand)
+{
+    int i;
+
+    printf("%d arguments\n", curCommand->numArguments);
+    fflush(stdout);
+
+    if(curCommand->fg == false)
+    {
+        printf("Background Process.\n");
+        fflush(stdout);
+    }
+    else
+    {
+        printf("Foreground Process.\n");
+        fflush(stdout);
+    }
+
+    for(i = 0; i < curCommand->numRedirections; i++)
+    {
+        printf("Redirect fd %d: type %d, fd %d, file %s\n", curCommand->redirections[i].fd,
+            curCommand->redirections[i].type, curCommand->redirections[i].sourceFD,
+            curCommand->redirections[i].word ? curCommand->redirections[i].word : "");
+        fflush(stdout);
+    }
+    
+    for(i = 0; i < curCommand->numArguments; i++)
+    {
+        printf("Argument %d: %s\n", i+1, curCommand->commands[i]);
+        fflush(stdout);
+    }
+}
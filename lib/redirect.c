@@ -0,0 +1,359 @@
+/*
+*   Redirection planning: the redirections of a command are turned
+*   into a list of fd operations in the parent and applied in the
+*   child before exec.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "smallsh.h"
+
+/*
+*   Put len bytes of data in an anonymous memory file and seal it so
+*   it can not be changed. Returns the file descriptor, positioned at
+*   the start, or -1 on error. No file is created in the filesystem,
+*   and the child reads the data directly as its stdin.
+*/
+int createSealedInput(const char* data, size_t len)
+{
+    int fd = memfd_create("smallsh-here", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    size_t written = 0;
+    ssize_t n;
+
+    if(fd == -1)
+    {
+        perror("memfd_create() failed");
+        fflush(stderr);
+        return -1;
+    }
+
+    while(written < len)
+    {
+        n = write(fd, data + written, len - written);
+        if(n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n == -1)
+        {
+            perror("here-document write failed");
+            fflush(stderr);
+            close(fd);
+            return -1;
+        }
+        written += n;
+    }
+
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+    lseek(fd, 0, SEEK_SET);
+
+    return fd;
+}
+
+/*
+*   Open the sealed memory file fd again for one run, from the start.
+*   Each open through /proc has an offset of its own, so runs that
+*   read it at once, such as jobs started in a loop, each get all the
+*   data. Without /proc it is a duplicate sharing the offset. Returns
+*   the new fd, or -1 if fd is -1 or on error.
+*/
+int reopenSealedInput(int fd)
+{
+    char path[64];
+    int newFD;
+
+    if(fd == -1)
+    {
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    newFD = open(path, O_RDONLY | O_CLOEXEC);
+    if(newFD == -1)
+    {
+        newFD = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    }
+    if(newFD != -1)
+    {
+        lseek(newFD, 0, SEEK_SET);
+    }
+
+    return newFD;
+}
+
+/*
+*   Move close-on-exec fd to FIRST_PLANNED_FD or above, so it can not
+*   be one a command names. Returns the new fd, or -1 if fd is -1.
+*/
+int moveToPlannedFD(int fd)
+{
+    int plannedFD;
+
+    if(fd == -1 || fd >= FIRST_PLANNED_FD)
+    {
+        return fd;
+    }
+
+    plannedFD = fcntl(fd, F_DUPFD_CLOEXEC, FIRST_PLANNED_FD);
+    close(fd);
+    return plannedFD;
+}
+
+/*
+*   Open file for a redirection of type, at a planned fd. The fd is
+*   close-on-exec, only its dup2 copy reaches the command. Returns the
+*   fd or -1 on error.
+*/
+int openRedirectFile(const char* file, enum redirectType type)
+{
+    int flags = O_RDONLY;
+
+    if(type == REDIRECT_OUTPUT)
+    {
+        flags = O_WRONLY | O_CREAT | O_TRUNC;
+    }
+    else if(type == REDIRECT_APPEND)
+    {
+        flags = O_WRONLY | O_CREAT | O_APPEND;
+    }
+
+    return moveToPlannedFD(open(file, flags | O_CLOEXEC, 0644));
+}
+
+/*
+*   Add an operation to the plan of curCommand.
+*/
+void addPlannedOp(struct commandElements* curCommand, int fd, int sourceFD, bool opened)
+{
+    struct redirectOp* op = &curCommand->plan[curCommand->numPlanned++];
+
+    op->fd = fd;
+    op->sourceFD = sourceFD;
+    op->opened = opened;
+}
+
+/*
+*   Plan the redirections of curCommand for this run, or of the alias
+*   command it runs if it has none of its own. Files are opened here
+*   in the parent, so a file that can not be opened is reported before
+*   forking. A background command reads and writes /dev/null unless
+*   its stdin or stdout is redirected, or with joblog capture its
+*   stdout and stderr go to a pipe read into the job's log. Returns
+*   false if a file could not be opened, then nothing is left open.
+*/
+bool planRedirections(struct shellContext* shell, struct commandElements* curCommand)
+{
+    struct commandElements* source = curCommand;
+    struct redirection* redirect;
+    bool inputRedirected = false;
+    bool outputRedirected = false;
+    bool errorRedirected = false;
+    int logPipe[2];
+    char* file;
+    int fd;
+    int i;
+
+    closeRedirections(curCommand);
+    if(curCommand->numRedirections == 0 && curCommand->redirectSource != NULL)
+    {
+        source = curCommand->redirectSource;
+    }
+
+    for(i = 0; i < source->numRedirections; i++)
+    {
+        inputRedirected |= source->redirections[i].fd == 0;
+        outputRedirected |= source->redirections[i].fd == 1;
+        errorRedirected |= source->redirections[i].fd == 2;
+    }
+    if(curCommand->bg && !inputRedirected)
+    {
+        addPlannedOp(curCommand, 0, openRedirectFile("/dev/null", REDIRECT_INPUT), true);
+    }
+
+    // Output of a background job is captured in a pipe the shell
+    // drains, or thrown away
+    if(curCommand->bg && !outputRedirected && shell->jobOutputMode != JOB_OUTPUT_NULL &&
+        pipe2(logPipe, O_CLOEXEC) == 0)
+    {
+        curCommand->logFD = moveToPlannedFD(logPipe[0]);
+        logPipe[1] = moveToPlannedFD(logPipe[1]);
+        addPlannedOp(curCommand, 1, logPipe[1], true);
+        if(!errorRedirected)
+        {
+            addPlannedOp(curCommand, 2, logPipe[1], false);
+        }
+    }
+    else if(curCommand->bg && !outputRedirected)
+    {
+        addPlannedOp(curCommand, 1, openRedirectFile("/dev/null", REDIRECT_OUTPUT), true);
+    }
+
+    for(i = 0; i < source->numRedirections; i++)
+    {
+        redirect = &source->redirections[i];
+        switch(redirect->type)
+        {
+            case REDIRECT_INPUT:
+            case REDIRECT_OUTPUT:
+            case REDIRECT_APPEND:
+                file = expandJoined(shell, redirect->word, &curCommand->expansion);
+                fd = openRedirectFile(file, redirect->type);
+                if(fd == -1)
+                {
+                    printf("cannot open %s for %s\n", file,
+                        redirect->type == REDIRECT_INPUT ? "input" : "output");
+                    fflush(stdout);
+                    closeRedirections(curCommand);
+                    return false;
+                }
+                addPlannedOp(curCommand, redirect->fd, fd, true);
+                break;
+            case REDIRECT_HERE:
+                // Memory file is read from the start on every run, the
+                // alias command's opened for this run like its own
+                if(source == curCommand)
+                {
+                    addPlannedOp(curCommand, redirect->fd, curCommand->inputFD, false);
+                }
+                else
+                {
+                    fd = moveToPlannedFD(reopenSealedInput(source->hereFD));
+                    addPlannedOp(curCommand, redirect->fd, fd, fd != -1);
+                }
+                break;
+            case REDIRECT_DUP:
+                addPlannedOp(curCommand, redirect->fd, redirect->sourceFD, false);
+                break;
+            case REDIRECT_CLOSE:
+                addPlannedOp(curCommand, redirect->fd, -1, false);
+                break;
+        }
+    }
+
+    return true;
+}
+
+/*
+*   Apply the planned redirections of curCommand in its child, in the
+*   order they were written. Exits the child if an fd it duplicates is
+*   not open.
+*/
+void applyRedirections(struct commandElements* curCommand)
+{
+    struct redirectOp* op;
+    int i;
+
+    // Pipes of process substitutions are named by the command's words
+    for(i = 0; i < curCommand->expansion.numFDs; i++)
+    {
+        fcntl(curCommand->expansion.fds[i], F_SETFD, 0);
+    }
+
+    for(i = 0; i < curCommand->numPlanned; i++)
+    {
+        op = &curCommand->plan[i];
+        if(op->sourceFD == -1)
+        {
+            close(op->fd);
+        }
+        else if(op->sourceFD == op->fd)
+        {
+            // N>&N keeps the fd, it must stay open across exec
+            fcntl(op->fd, F_SETFD, 0);
+        }
+        else if(dup2(op->sourceFD, op->fd) == -1)
+        {
+            fprintf(stderr, "%d: %s\n", op->sourceFD, strerror(errno));
+            fflush(stderr);
+            fflush(stdout);
+            _exit(1);
+        }
+    }
+}
+
+/*
+*   Close the files the parent opened for the plan of curCommand,
+*   once the child has them, and a job log pipe not taken by a job.
+*/
+void closeRedirections(struct commandElements* curCommand)
+{
+    int i;
+
+    if(curCommand->logFD != -1)
+    {
+        close(curCommand->logFD);
+        curCommand->logFD = -1;
+    }
+
+    for(i = 0; i < curCommand->numPlanned; i++)
+    {
+        if(curCommand->plan[i].opened && curCommand->plan[i].sourceFD != -1)
+        {
+            close(curCommand->plan[i].sourceFD);
+        }
+    }
+    curCommand->numPlanned = 0;
+}
+
+/*
+*   Put back the fds a group changed, from the first count entries of
+*   saved, in the reverse order they were changed.
+*/
+void restoreShellRedirections(struct commandElements* curCommand, int* saved, int count)
+{
+    int i;
+
+    fflush(stdout);
+    for(i = count - 1; i >= 0; i--)
+    {
+        if(saved[i] == -1)
+        {
+            close(curCommand->plan[i].fd);
+        }
+        else
+        {
+            dup2(saved[i], curCommand->plan[i].fd);
+            close(saved[i]);
+        }
+    }
+}
+
+/*
+*   Apply the planned redirections of curCommand in the shell itself,
+*   for a { list; } group that runs without a child. Each fd changed
+*   is saved first in saved, -1 if it was not open. Returns false,
+*   with the fds put back, if an fd it duplicates is not open.
+*/
+bool applyShellRedirections(struct commandElements* curCommand, int* saved)
+{
+    struct redirectOp* op;
+    int i;
+
+    // Output printed before the group goes where it was meant to
+    fflush(stdout);
+    for(i = 0; i < curCommand->numPlanned; i++)
+    {
+        op = &curCommand->plan[i];
+        saved[i] = fcntl(op->fd, F_DUPFD_CLOEXEC, FIRST_PLANNED_FD);
+        if(op->sourceFD == -1)
+        {
+            close(op->fd);
+        }
+        else if(op->sourceFD != op->fd && dup2(op->sourceFD, op->fd) == -1)
+        {
+            fprintf(stderr, "%d: %s\n", op->sourceFD, strerror(errno));
+            fflush(stderr);
+            restoreShellRedirections(curCommand, saved, i + 1);
+            return false;
+        }
+    }
+
+    return true;
+}
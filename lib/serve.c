@@ -0,0 +1,228 @@
+/*
+*   Server mode. smallsh --serve SOCKET listens on a UNIX domain
+*   socket and runs the command lines each client sends in a session
+*   of its own, a forked copy of the shell with its own working
+*   directory, variables, functions and job table.
+*
+*   Output of the commands is sent back on the socket. After each line
+*   a status record is sent, a line starting with STATUS_RECORD:
+*   \036status="exit value 0" real_us=N user_us=N sys_us=N maxrss_kb=N
+*   The record is for the whole line, however many commands it has:
+*   status is that of its last command, and the times are for the
+*   foreground children the line waited on. maxrss_kb is the largest
+*   resident set of any child of the session so far, a high-water
+*   mark the kernel keeps, not the peak of this line alone.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/signalfd.h>
+#include <sys/resource.h>
+
+#include "smallsh.h"
+
+#define STATUS_RECORD '\036'
+#define SERVER_BACKLOG 64
+
+/*
+*   Returns microseconds of a timeval.
+*/
+long timevalMicros(struct timeval* tv)
+{
+    return tv->tv_sec * 1000000L + tv->tv_usec;
+}
+
+/*
+*   Send the status record for a line that started at start, with
+*   before the child usage at that time.
+*/
+void sendStatusRecord(struct shellContext* shell, struct timespec* start, struct rusage* before)
+{
+    struct timespec end;
+    struct rusage after;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    getrusage(RUSAGE_CHILDREN, &after);
+
+    printf("%cstatus=\"%s\" real_us=%ld user_us=%ld sys_us=%ld maxrss_kb=%ld\n",
+        STATUS_RECORD, shell->exitStatus,
+        (end.tv_sec - start->tv_sec) * 1000000L + (end.tv_nsec - start->tv_nsec) / 1000,
+        timevalMicros(&after.ru_utime) - timevalMicros(&before->ru_utime),
+        timevalMicros(&after.ru_stime) - timevalMicros(&before->ru_stime),
+        after.ru_maxrss);
+    fflush(stdout);
+}
+
+/*
+*   Run a client session on the connected socket client. The socket
+*   becomes the shell's input and output, so here-documents and loops
+*   read their lines as they would from a script. Returns at end of
+*   input or on exit.
+*/
+void runSession(struct shellContext* shell, int client)
+{
+    struct commandNode* curNode;
+    struct timespec start;
+    struct rusage before;
+    bool isExiting = false;
+    bool endOfInput = false;
+
+    dup2(client, STDIN_FILENO);
+    dup2(client, STDOUT_FILENO);
+    dup2(client, STDERR_FILENO);
+    close(client);
+    shell->serving = true;
+
+    do
+    {
+        curNode = getCommandLine(shell, &endOfInput);
+
+        if(curNode != NULL)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            getrusage(RUSAGE_CHILDREN, &before);
+            isExiting = runNodeList(shell, curNode);
+            freeNodeList(curNode);
+            sendStatusRecord(shell, &start, &before);
+        }
+
+        checkBGProcesses(shell);
+
+        if(endOfInput && !isExiting)
+        {
+            runExitCommand(shell);
+            isExiting = true;
+        }
+    }
+    while(!isExiting);
+
+    fflush(stdout);
+}
+
+/*
+*   Reap finished sessions without waiting.
+*/
+void reapSessions()
+{
+    while(waitpid(-1, NULL, WNOHANG) > 0)
+    {
+    }
+}
+
+/*
+*   Listen on socketPath and fork a session for each client. SIGCHLD
+*   is read from a signalfd polled with the socket, so a session is
+*   reaped as soon as it ends and not at the next accept. Only
+*   returns if the socket could not be set up.
+*/
+int runServer(struct shellContext* shell, const char* socketPath)
+{
+    struct sockaddr_un address = {0};
+    struct signalfd_siginfo signalInfo;
+    struct pollfd fds[2];
+    struct stat info;
+    sigset_t childMask;
+    sigset_t savedMask;
+    int server;
+    int client;
+    pid_t spawnpid;
+
+    if(strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "smallsh: socket path too long: %s\n", socketPath);
+        return EXIT_FAILURE;
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+
+    server = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(server == -1)
+    {
+        perror("socket");
+        return EXIT_FAILURE;
+    }
+
+    // Replace a socket left by an earlier server, but nothing else
+    if(lstat(socketPath, &info) == 0)
+    {
+        if(!S_ISSOCK(info.st_mode))
+        {
+            fprintf(stderr, "smallsh: %s: not a socket\n", socketPath);
+            close(server);
+            return EXIT_FAILURE;
+        }
+        unlink(socketPath);
+    }
+    if(bind(server, (struct sockaddr*)&address, sizeof(address)) == -1 ||
+        listen(server, SERVER_BACKLOG) == -1)
+    {
+        perror(socketPath);
+        close(server);
+        return EXIT_FAILURE;
+    }
+
+    sigemptyset(&childMask);
+    sigaddset(&childMask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &childMask, &savedMask);
+    fds[0].fd = server;
+    fds[0].events = POLLIN;
+    fds[1].fd = signalfd(-1, &childMask, SFD_NONBLOCK | SFD_CLOEXEC);
+    fds[1].events = POLLIN;
+
+    while(true)
+    {
+        if(poll(fds, 2, -1) == -1)
+        {
+            continue;
+        }
+        if(fds[1].revents != 0)
+        {
+            while(read(fds[1].fd, &signalInfo, sizeof(signalInfo)) > 0)
+            {
+            }
+            reapSessions();
+        }
+        if(fds[0].revents == 0)
+        {
+            continue;
+        }
+
+        client = accept4(server, NULL, NULL, SOCK_CLOEXEC);
+        if(client == -1)
+        {
+            if(errno != EINTR)
+            {
+                perror("accept");
+            }
+            continue;
+        }
+
+        spawnpid = fork();
+        if(spawnpid == 0)
+        {
+            close(server);
+            close(fds[1].fd);
+            sigprocmask(SIG_SETMASK, &savedMask, NULL);
+            openSessionBoard(shell, getenv("SMALLSH_BOARD"));
+            runSession(shell, client);
+            closeStatusBoard(shell);
+            _exit(EXIT_SUCCESS);
+        }
+        if(spawnpid == -1)
+        {
+            perror("fork");
+        }
+
+        close(client);
+    }
+}
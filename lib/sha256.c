@@ -0,0 +1,130 @@
+/*
+*   SHA-256, the digest the cache names its keys and blobs by, so two
+*   different inputs or contents can not share a name the way they
+*   could with a 64-bit hash. Data is added in pieces with
+*   sha256Update and the digest is read out in hex.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "smallsh.h"
+
+#define ROTATE_RIGHT(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+const uint32_t sha256Constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+/*
+*   Start digest with no data added.
+*/
+void sha256Init(struct sha256Context* digest)
+{
+    const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+    memcpy(digest->state, initial, sizeof(initial));
+    digest->length = 0;
+    digest->blockLen = 0;
+}
+
+/*
+*   Mix the full block of digest into its state.
+*/
+void sha256Block(struct sha256Context* digest)
+{
+    uint32_t w[64];
+    uint32_t s[8];
+    uint32_t t1;
+    uint32_t t2;
+    int i;
+
+    for(i = 0; i < 16; i++)
+    {
+        w[i] = (uint32_t)digest->block[i * 4] << 24 | (uint32_t)digest->block[i * 4 + 1] << 16 |
+            (uint32_t)digest->block[i * 4 + 2] << 8 | digest->block[i * 4 + 3];
+    }
+    for(i = 16; i < 64; i++)
+    {
+        w[i] = w[i - 16] + w[i - 7] +
+            (ROTATE_RIGHT(w[i - 15], 7) ^ ROTATE_RIGHT(w[i - 15], 18) ^ (w[i - 15] >> 3)) +
+            (ROTATE_RIGHT(w[i - 2], 17) ^ ROTATE_RIGHT(w[i - 2], 19) ^ (w[i - 2] >> 10));
+    }
+
+    memcpy(s, digest->state, sizeof(s));
+    for(i = 0; i < 64; i++)
+    {
+        t1 = s[7] + (ROTATE_RIGHT(s[4], 6) ^ ROTATE_RIGHT(s[4], 11) ^ ROTATE_RIGHT(s[4], 25)) +
+            ((s[4] & s[5]) ^ (~s[4] & s[6])) + sha256Constants[i] + w[i];
+        t2 = (ROTATE_RIGHT(s[0], 2) ^ ROTATE_RIGHT(s[0], 13) ^ ROTATE_RIGHT(s[0], 22)) +
+            ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+        memmove(s + 1, s, 7 * sizeof(uint32_t));
+        s[4] += t1;
+        s[0] = t1 + t2;
+    }
+    for(i = 0; i < 8; i++)
+    {
+        digest->state[i] += s[i];
+    }
+}
+
+/*
+*   Add len bytes of data to digest.
+*/
+void sha256Update(struct sha256Context* digest, const void* data, size_t len)
+{
+    const unsigned char* c = data;
+    size_t n;
+
+    digest->length += len;
+    while(len > 0)
+    {
+        n = 64 - digest->blockLen < len ? 64 - digest->blockLen : len;
+        memcpy(digest->block + digest->blockLen, c, n);
+        digest->blockLen += n;
+        c += n;
+        len -= n;
+        if(digest->blockLen == 64)
+        {
+            sha256Block(digest);
+            digest->blockLen = 0;
+        }
+    }
+}
+
+/*
+*   Finish digest and write it to hex as SHA256_HEX_SIZE - 1 lower
+*   case hex digits and a 0.
+*/
+void sha256Hex(struct sha256Context* digest, char* hex)
+{
+    uint64_t bits = digest->length * 8;
+    unsigned char pad = 0x80;
+    unsigned char zero = 0;
+    unsigned char lengthBytes[8];
+    int i;
+
+    sha256Update(digest, &pad, 1);
+    while(digest->blockLen != 56)
+    {
+        sha256Update(digest, &zero, 1);
+    }
+    for(i = 0; i < 8; i++)
+    {
+        lengthBytes[i] = bits >> (56 - i * 8);
+    }
+    sha256Update(digest, lengthBytes, 8);
+
+    for(i = 0; i < 8; i++)
+    {
+        sprintf(hex + i * 8, "%08x", digest->state[i]);
+    }
+}
@@ -0,0 +1,126 @@
+/*
+*   Shell state and signal handling.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include "smallsh.h"
+
+/* struct for handling SIGINT */
+struct sigaction SIGINT_action = {0};
+struct sigaction SIGTSTP_action = {0};
+
+// Shell whose foreground-only mode SIGTSTP toggles
+struct shellContext* signalShell = NULL;
+
+/*
+*   Handle SIGSTP by checking if the shell is in foreground-only mode. Toggle
+*   value and print appropriate message.
+*/
+void handle_SIGTSTP(int signo)
+{
+    (void)signo;
+
+    if(signalShell->foregroundOnly)
+    {
+        signalShell->foregroundOnly = false;
+        write(STDOUT_FILENO, "\nExiting foreground-only mode\n", 31);
+    }
+    else
+    {
+        signalShell->foregroundOnly = true;
+        write(STDOUT_FILENO, "\nEntering foreground-only mode (& is now ignored)\n", 51);
+    }
+    if(signalShell->board != NULL)
+    {
+        __atomic_store_n(&signalShell->board->foregroundOnly, signalShell->foregroundOnly, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+*   Initialize first exitStatus
+*/
+void initializeExitStatus(struct shellContext* shell)
+{
+    strcpy(shell->exitStatus, "exit value 0");
+}
+
+/*
+*   Fill out SIGINT_action struct. Register SIG_IGN as the
+*   signal handler.
+*/
+void initializeSIGINT()
+{
+    SIGINT_action.sa_handler = SIG_IGN; // ignore as a default
+    sigfillset(&SIGINT_action.sa_mask); // block all catchable signals while handle_SIGINT is running
+    SIGINT_action.sa_flags = 0; // no flags set
+    sigaction(SIGINT, &SIGINT_action, NULL);
+}
+
+/*
+*   Fill out SIGSTP_action struct. Register handle_SIGSTP as the
+*   signal handler.
+*/
+void initializeSIGTSTP(struct shellContext* shell)
+{
+    signalShell = shell;
+    SIGTSTP_action.sa_handler = handle_SIGTSTP;
+    sigfillset(&SIGTSTP_action.sa_mask); 
+    // block all catchable signals while handle_SIGSTP is running
+    SIGTSTP_action.sa_flags = 0; // no flags set
+    sigaction(SIGTSTP, &SIGTSTP_action, NULL);
+}
+
+/*
+*   Create the state of a new shell, with an empty job table, the
+*   first exitStatus and the environment it was started with.
+*/
+struct shellContext* createShell()
+{
+    struct shellContext* shell = calloc(1, sizeof(struct shellContext));
+
+    initializePIDList(shell);
+    initializeExitStatus(shell);
+    initializeEnvironment(shell);
+    shell->timerFD = -1;
+    shell->scriptFD = STDIN_FILENO;
+
+    return shell;
+}
+
+/*
+*   Forget the background jobs, timeouts, job logs and board of the parent in
+*   a shell forked to run commands, so the child does not wait for,
+*   signal or read from what belongs to the parent.
+*/
+void resetChildShell(struct shellContext* shell)
+{
+    int i;
+
+    initializePIDList(shell);
+    shell->tailCommand = NULL;
+    closeStatusBoard(shell);
+
+    shell->deadlines.numEntries = 0;
+    if(shell->timerFD != -1)
+    {
+        close(shell->timerFD);
+        shell->timerFD = -1;
+    }
+
+    for(i = 0; i < shell->jobLogs.numLogs; i++)
+    {
+        if(shell->jobLogs.logs[i].fd != -1)
+        {
+            close(shell->jobLogs.logs[i].fd);
+        }
+        free(shell->jobLogs.logs[i].ring);
+        free(shell->jobLogs.logs[i].partial);
+    }
+    shell->jobLogs.numLogs = 0;
+    shell->jobLogs.numOpen = 0;
+}
@@ -0,0 +1,472 @@
+#ifndef SMALLSH_H
+#define SMALLSH_H
+
+/*
+*   libsmallsh, the core of smallsh. A command line goes through
+*   these stages, each with its own file:
+*   lexing and expansion (lex.c), parsing into command structures
+*   (parse.c), redirection planning (redirect.c), and running
+*   (exec.c) with the job table (jobs.c). All state of a shell is in
+*   a struct shellContext, so stages can be run and measured on their
+*   own.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+#include <sys/types.h>
+
+#include "board.h"
+
+#define MAX_COMMAND_LINE_LENGTH 2049 // 2048 characters plus null at the end
+#define MAX_COMMAND_LINE_ARGUMENTS 512
+#define NUM_BUILT_INS 15
+#define MAX_REDIRECTIONS 16
+#define MAX_PLANNED_OPS (MAX_REDIRECTIONS + 3)  // plus /dev/null in, log out, log err
+#define MAX_ASSIGNMENTS 16      // NAME=value words before a command
+#define FIRST_PLANNED_FD 10  // files opened for a child start here
+#define DEFAULT_TIMEOUT_GRACE 5000000000LL  // ns from timeout to SIGKILL
+#define DEFAULT_SHUTDOWN_GRACE 2000000000LL // ns from exit's SIGTERM to SIGKILL
+#define DEFAULT_ONCHANGE_DEBOUNCE 20000000LL // ns changes must stop for
+#define JOB_LOG_SIZE 65536      // bytes of output kept per background job
+#define MAX_JOB_LOGS 64         // logs kept, oldest finished ones dropped
+#define MAX_TAGGED_LINE 4096    // longer lines are printed in parts
+#define SHA256_HEX_SIZE 65      // hex digits of a digest and the 0
+
+extern const char* builtInCommands[NUM_BUILT_INS];
+
+/* struct for a list of words that owns the memory they point into */
+struct wordList
+{
+    char** words;
+    int numWords;
+    int capacity;
+    char** buffers;     // malloc'd memory the words point into
+    int numBuffers;
+    int* fds;           // shell ends of <( ) and >( ) pipes, which
+    int numFDs;         // the words name as /dev/fd/N
+};
+
+/* types of redirections */
+enum redirectType
+{
+    REDIRECT_INPUT,     // N<file
+    REDIRECT_OUTPUT,    // N>file
+    REDIRECT_APPEND,    // N>>file
+    REDIRECT_HERE,      // N<<word or N<<<word, input is inputFD
+    REDIRECT_DUP,       // N>&M or N<&M
+    REDIRECT_CLOSE      // N>&- or N<&-
+};
+
+/* struct for a redirection as parsed */
+struct redirection
+{
+    enum redirectType type;
+    int fd;             // fd of the command that is redirected
+    int sourceFD;       // M of N>&M
+    char* word;         // file as parsed
+};
+
+/*
+*   struct for an operation on the fds of a child, planned in the
+*   parent: dup2(sourceFD, fd), or close(fd) if sourceFD is -1.
+*/
+struct redirectOp
+{
+    int fd;
+    int sourceFD;
+    bool opened;        // sourceFD is a file the parent opened
+};
+
+/* struct for command line elements */
+struct commandElements
+{
+    char* commands[MAX_COMMAND_LINE_ARGUMENTS];
+    // char* exitStatus;
+    bool fg;    // false if & found at end of command line
+    bool bg;    // true if & found at end of command line
+    bool ignore;    // If command line is blank or a comment
+    int pid;
+    int numArguments;
+    char* words[MAX_COMMAND_LINE_ARGUMENTS];    // words as parsed, they
+                                                // are expanded into
+                                                // commands on each run
+    int numWords;
+    struct redirection redirections[MAX_REDIRECTIONS];  // in order
+    int numRedirections;
+    struct commandElements* redirectSource; // alias command whose
+                                            // redirections are used
+    struct redirectOp plan[MAX_PLANNED_OPS];  // ops for this run
+    int numPlanned;
+    char* hereStringWord;   // <<< word as parsed
+    bool isAssignment;      // command is only NAME=value words
+    char* assignments[MAX_ASSIGNMENTS];  // NAME=value words before
+    int numAssignments;                  // the command, as parsed
+    char* overlay[MAX_ASSIGNMENTS];  // expanded NAME=value for this run
+    struct wordList expansion;  // memory of expanded commands and files
+    char* hereDelimiter;    // set if << here-document body still to read
+    bool hereQuoted;        // true if delimiter was quoted, no expansion
+    char* hereBody;         // here-document body as read
+    int hereFD;     // sealed memfd with here-document body if it does
+                    // not need expanding on each run, or -1
+    int inputFD;    // memfd used as input on this run, or -1
+    int logFD;      // read end of the output pipe of a background
+                    // job on this run, or -1
+    int execStatusFD;   // write end of the exec status pipe in a
+                        // foreground child, or -1
+    long long timeout;      // ns a child run by timeout may take, or 0
+    int timeoutSignal;      // signal sent at the timeout
+    long long timeoutGrace; // ns from the signal to SIGKILL, or 0
+    // struct commandElements* next;
+};
+
+/* types of nodes in a parsed command line */
+enum nodeType
+{
+    NODE_COMMAND,
+    NODE_FOR,
+    NODE_WHILE,
+    NODE_FUNCTION,   // function definition
+    NODE_BACKGROUND, // && || list run in a background child
+    NODE_GROUP,      // { list; } run in this shell
+    NODE_SUBSHELL    // ( list ) run in one child
+};
+
+/* how a node is joined to the one before it in a list */
+enum listConnector
+{
+    LIST_ALWAYS,    // ; or a new line
+    LIST_AND,       // &&, runs if the last command succeeded
+    LIST_OR         // ||, runs if the last command failed
+};
+
+/*
+*   struct for a node of a parsed command line. Lists of nodes are
+*   linked with next. Loop bodies are parsed once and only expanded
+*   again on each iteration.
+*/
+struct commandNode
+{
+    enum nodeType type;
+    struct commandElements* command;    // NODE_COMMAND, or the
+                                        // redirections of a list
+    char* variable;                     // NODE_FOR loop variable, or
+                                        // NODE_FUNCTION name
+    char** loopWords;                   // NODE_FOR words after in
+    int numLoopWords;
+    struct commandNode* condition;      // NODE_WHILE condition list
+    struct commandNode* body;           // loop, function, group or
+                                        // background list body
+    enum listConnector connector;       // joins it to the node before
+    struct commandNode* next;
+};
+
+/* struct for a string keyed hash table entry */
+struct hashEntry
+{
+    char* key;
+    void* value;
+    struct hashEntry* next;
+};
+
+/* struct for a string keyed hash table with chained buckets */
+struct hashTable
+{
+    struct hashEntry** buckets;
+    int numBuckets;
+    int numEntries;
+};
+
+/* struct for an alias, the text it was defined with and its parse */
+struct shellAlias
+{
+    char* text;
+    struct commandNode* body;
+};
+
+/* struct for the deadline of a child run by timeout */
+struct deadline
+{
+    long long when;     // CLOCK_MONOTONIC ns
+    pid_t pid;
+    int signal;         // signal to send at when
+    long long grace;    // ns from signal to SIGKILL, or 0
+    bool fired;         // child has been signalled
+};
+
+/* struct for a min heap of deadlines by time */
+struct deadlineHeap
+{
+    struct deadline* entries;
+    int numEntries;
+    int capacity;
+};
+
+/* modes for the output of background jobs that is not redirected */
+enum jobOutputMode
+{
+    JOB_OUTPUT_NULL,        // to /dev/null
+    JOB_OUTPUT_CAPTURE,     // kept in a log per job
+    JOB_OUTPUT_TAG          // kept, and printed line by line tagged
+                            // with the pid
+};
+
+/* struct for the captured stdout and stderr of a background job */
+struct jobLog
+{
+    pid_t pid;
+    int fd;             // read end of the job's pipe, -1 at its end
+    char* ring;         // last JOB_LOG_SIZE bytes of output
+    size_t start;       // index of the oldest byte in ring
+    size_t length;
+    size_t dropped;     // bytes overwritten by newer output
+    char* partial;      // tag mode, line not finished yet
+    int partialLen;
+};
+
+/* struct for the logs of background jobs, oldest first */
+struct jobLogList
+{
+    struct jobLog* logs;
+    int numLogs;
+    int capacity;
+    int numOpen;        // logs with fd still open
+};
+
+/*
+*   struct for the environment of children, a NULL terminated envp
+*   vector kept ready for exec and the slot of each name in it
+*/
+struct environment
+{
+    char** envp;            // malloc'd "NAME=value" strings
+    int numEntries;
+    int capacity;
+    struct hashTable slots; // name to slot + 1
+};
+
+/* struct for a SHA-256 digest of the data added so far */
+struct sha256Context
+{
+    uint32_t state[8];
+    uint64_t length;            // bytes added
+    unsigned char block[64];    // bytes not yet mixed in
+    size_t blockLen;
+};
+
+/* struct for the counts cache --stats reports */
+struct cacheStats
+{
+    long hits;
+    long misses;
+    long uncached;      // run without the cache, with >> or &
+};
+
+/*
+*   struct for the state of one shell. Everything that runs commands
+*   is given the shell it runs them for.
+*/
+struct shellContext
+{
+    int processIDs[MAX_COMMAND_LINE_ARGUMENTS]; // Holds running bg processes
+    bool silentJobs[MAX_COMMAND_LINE_ARGUMENTS];  // reaped without a
+                                                  // report, <( ) jobs
+    char exitStatus[256]; // Hold exitStatus
+    bool foregroundOnly; // determines if fg only mode
+    struct hashTable variables;  // values are malloc'd strings
+    struct environment environment;  // exported variables
+    struct hashTable functions;  // values are function bodies
+    struct hashTable aliases;    // values are struct shellAlias
+    int commandDepth;        // commands running, nested by functions
+                             // and aliases
+    struct commandNode* retiredBodies;  // group nodes of bodies replaced
+                                        // while running, freed when
+                                        // commandDepth is back to 0
+    char** positionalArgs;   // arguments of the function being run,
+    int numPositionalArgs;   // $1 to $9, $# and $@
+    bool serving;            // running a --serve session, no prompt
+    int scriptFD;            // lines are read from, stdin or the text
+                             // of -c
+    struct commandElements* tailCommand;  // last command of a script,
+                                          // exec'd in place of the shell
+    struct deadlineHeap deadlines;  // timeouts of running children
+    int timerFD;             // timerfd armed for the first deadline,
+                             // -1 until a timeout is used
+    enum jobOutputMode jobOutputMode;  // set by joblog
+    struct jobLogList jobLogs;
+    struct cacheStats cacheStats;
+    struct statusBoard* board;  // mapped status board, or NULL
+    struct hashTable arithCache;  // parsed $(( )) and let expressions
+                                  // by text
+    struct hashTable globCache;   // compiled ${ } patterns by text
+    bool expansionFailed;    // an expansion of the command being run
+                             // failed, so it is not run
+};
+
+
+/* struct for handling SIGINT */
+extern struct sigaction SIGINT_action;
+extern struct sigaction SIGTSTP_action;
+
+// Shell state, shell.c
+struct shellContext* createShell();
+void initializeExitStatus(struct shellContext* shell);
+void initializeSIGINT();
+void initializeSIGTSTP(struct shellContext* shell);
+void resetChildShell(struct shellContext* shell);
+
+// String keyed hash table, hash.c
+unsigned long hashString(const char* key);
+void* hashLookup(struct hashTable* table, const char* key);
+void* hashInsert(struct hashTable* table, const char* key, void* value);
+void* hashRemove(struct hashTable* table, const char* key);
+void clearHashTable(struct hashTable* table);
+
+// Line lexing and expansion, lex.c
+char* replaceString(char* commandLineCopy);
+char* findWordEnd(char* line);
+char* nextWord(char** cursor);
+int variableNameLength(const char* text);
+bool isAssignmentWord(const char* word);
+const char* getVariable(struct shellContext* shell, const char* name);
+void setVariable(struct shellContext* shell, const char* name, const char* value);
+void addWord(struct wordList* list, char* word);
+void addOwnedBuffer(struct wordList* list, char* buffer);
+void addOwnedFD(struct wordList* list, int fd);
+void closeOwnedFDs(struct wordList* list);
+void clearWordList(struct wordList* list);
+void appendToField(char** field, int* fieldLen, const char* text, int len);
+int expandWord(struct shellContext* shell, const char* word, struct wordList* fields, bool split);
+char* expandJoined(struct shellContext* shell, const char* word, struct wordList* fields);
+void expandCommand(struct shellContext* shell, struct commandElements* curCommand);
+void releaseExpansion(struct commandElements* curCommand);
+char* runCommandSubstitution(struct shellContext* shell, const char* innerLine);
+
+// Parsing into command structures, parse.c
+struct commandElements* parseCommandLine(struct shellContext* shell, char* commandLine);
+struct commandNode* parseLine(struct shellContext* shell, char* line, bool canReadMore);
+struct commandNode* getCommandLine(struct shellContext* shell, bool* endOfInput);
+void freeCommand(struct commandElements* curCommand);
+void freeNodeList(struct commandNode* node);
+void printCommandElements(struct commandElements* curCommand);
+
+// Redirection planning, redirect.c
+int createSealedInput(const char* data, size_t len);
+int reopenSealedInput(int fd);
+int moveToPlannedFD(int fd);
+void addPlannedOp(struct commandElements* curCommand, int fd, int sourceFD, bool opened);
+bool planRedirections(struct shellContext* shell, struct commandElements* curCommand);
+void applyRedirections(struct commandElements* curCommand);
+void closeRedirections(struct commandElements* curCommand);
+bool applyShellRedirections(struct commandElements* curCommand, int* saved);
+void restoreShellRedirections(struct commandElements* curCommand, int* saved, int count);
+
+// Environment of children, env.c
+void initializeEnvironment(struct shellContext* shell);
+int findEnvironmentSlot(struct shellContext* shell, const char* name, int len);
+const char* getEnvironmentValue(struct shellContext* shell, const char* name);
+void exportVariable(struct shellContext* shell, const char* name, const char* value);
+void unexportVariable(struct shellContext* shell, const char* name);
+void overlayEnvironment(struct shellContext* shell, struct commandElements* curCommand);
+void runExportCommand(struct shellContext* shell, struct commandElements* curCommand);
+void runUnsetCommand(struct shellContext* shell, struct commandElements* curCommand);
+
+// Job table, jobs.c
+void initializePIDList(struct shellContext* shell);
+void addToPIDList(struct shellContext* shell, int pid);
+void removeFromPIDList(struct shellContext* shell, int pid);
+void addSilentJob(struct shellContext* shell, int pid);
+bool isSilentJob(struct shellContext* shell, int pid);
+void reportBGProcess(struct shellContext* shell, pid_t pid, int childExitStatus);
+void checkBGProcesses(struct shellContext* shell);
+void shutdownJobs(struct shellContext* shell, bool drain, long long grace);
+void runExitCommand(struct shellContext* shell);
+
+// Running commands, exec.c
+int findBuiltIn(const char* command);
+bool isShellCommand(struct shellContext* shell, const char* command);
+bool runCommands(struct shellContext* shell, struct commandElements* curCommand);
+void runOtherCommands(struct shellContext* shell, struct commandElements* curCommand);
+bool canTailExec(struct shellContext* shell, struct commandElements* curCommand);
+void markTailCommand(struct shellContext* shell, struct commandNode* node);
+void runExecCommand(struct shellContext* shell, struct commandElements* curCommand);
+void runRedirectedBuiltIn(struct shellContext* shell, struct commandElements* curCommand,
+    void (*runBuiltIn)(struct shellContext*, struct commandElements*));
+void runFGProcess(struct shellContext* shell, struct commandElements* curCommand);
+void runFGParent(struct shellContext* shell, pid_t spawnpid, struct commandElements* curCommand);
+void runFGChild(struct shellContext* shell, struct commandElements* curCommand);
+pid_t startFGProcess(struct shellContext* shell, struct commandElements* curCommand);
+pid_t runBGProcess(struct shellContext* shell, struct commandElements* curCommand);
+bool runNode(struct shellContext* shell, struct commandNode* node);
+bool runNodeList(struct shellContext* shell, struct commandNode* node);
+bool lastCommandSucceeded(struct shellContext* shell);
+int exitStatusCode(struct shellContext* shell);
+
+// Line editing and completion, lineedit.c
+bool readCommandLine(struct shellContext* shell, char* line, int size);
+bool isInputExhausted(struct shellContext* shell);
+
+// Timeouts of children, timeout.c
+long long monotonicNs();
+long long parseDuration(const char* text);
+int parseSignal(const char* text);
+void addDeadline(struct shellContext* shell, pid_t pid, long long timeout, int signo, long long grace);
+bool removeDeadline(struct shellContext* shell, pid_t pid);
+void fireDeadlines(struct shellContext* shell);
+
+// Event loop, events.c
+bool hasShellEvents(struct shellContext* shell);
+int waitForEvents(struct shellContext* shell, const int* waited, int numWaited);
+bool waitForEvent(struct shellContext* shell, int fd);
+pid_t waitForChild(struct shellContext* shell, pid_t pid, int* status);
+bool waitForInput(struct shellContext* shell);
+
+// Captured output of background jobs, joblog.c
+void addJobLog(struct shellContext* shell, pid_t pid, int fd);
+bool drainJobLog(struct shellContext* shell, struct jobLog* log);
+void drainJobOutput(struct shellContext* shell, pid_t pid);
+void runJobLogCommand(struct shellContext* shell, struct commandElements* curCommand);
+
+// Rerunning a command on changes, onchange.c
+void runOnchangeCommand(struct shellContext* shell, struct commandElements* curCommand);
+
+// cat and tee without a child, copy.c
+void catchCopySIGINT(struct sigaction* saved);
+bool releaseCopySIGINT(const struct sigaction* saved);
+bool copyFD(int inFD, off_t* offset, int outFD);
+bool hasCopyOptions(struct commandElements* curCommand);
+void runCatCommand(struct shellContext* shell, struct commandElements* curCommand);
+void runTeeCommand(struct shellContext* shell, struct commandElements* curCommand);
+
+// Memoized commands, cache.c
+void runCacheCommand(struct shellContext* shell, struct commandElements* curCommand);
+
+// SHA-256 digests of cache keys and blobs, sha256.c
+void sha256Init(struct sha256Context* digest);
+void sha256Update(struct sha256Context* digest, const void* data, size_t len);
+void sha256Hex(struct sha256Context* digest, char* hex);
+
+// Arithmetic expansion and let, arith.c
+bool evaluateArithmetic(struct shellContext* shell, const char* text, long long* result);
+void runLetCommand(struct shellContext* shell, struct commandElements* curCommand);
+
+// Parameter expansion operators, params.c
+char* expandParameter(struct shellContext* shell, const char* inner, struct wordList* fields);
+
+// Parallel scripts, parallel.c
+int runParallelScript(struct shellContext* shell, int argc, char* argv[]);
+
+// Status board for monitors, board.c
+void openStatusBoard(struct shellContext* shell, const char* path);
+void closeStatusBoard(struct shellContext* shell);
+void openSessionBoard(struct shellContext* shell, const char* path);
+void postBoardJob(struct shellContext* shell, pid_t pid, char* const* words, int numWords);
+void finishBoardJob(struct shellContext* shell, pid_t pid, int waitStatus);
+void postBoardForeground(struct shellContext* shell, pid_t pid, char* const* words, int numWords);
+void waitForBoardForeground(struct shellContext* shell, pid_t pid);
+
+// Server mode over a UNIX socket, serve.c
+void runSession(struct shellContext* shell, int client);
+int runServer(struct shellContext* shell, const char* socketPath);
+
+#endif
@@ -0,0 +1,260 @@
+/*
+*   Timeouts of child processes. Deadlines are kept in a min heap by
+*   time, and one timerfd is armed for the first of them, which the
+*   event loop (events.c) polls along with what it waits for.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+#include "smallsh.h"
+
+#define NO_DEADLINE LLONG_MAX   // fired with nothing more to send
+
+/*
+*   Returns nanoseconds from CLOCK_MONOTONIC, the clock of the timer.
+*/
+long long monotonicNs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+*   Parse a duration, a number of seconds that may have a fraction and
+*   a suffix s, m, h or d. Returns nanoseconds, or -1 if it is not
+*   valid.
+*/
+long long parseDuration(const char* text)
+{
+    char* end;
+    double value = strtod(text, &end);
+    double scale = 1e9;
+
+    if(end == text || value < 0)
+    {
+        return -1;
+    }
+
+    switch(*end)
+    {
+        case 0:
+        case 's':
+            break;
+        case 'm':
+            scale *= 60;
+            break;
+        case 'h':
+            scale *= 60 * 60;
+            break;
+        case 'd':
+            scale *= 24 * 60 * 60;
+            break;
+        default:
+            return -1;
+    }
+    if(*end != 0 && end[1] != 0)
+    {
+        return -1;
+    }
+
+    return (long long)(value * scale);
+}
+
+/*
+*   Parse a signal number or name, with or without SIG. Returns -1 if
+*   it is not a signal.
+*/
+int parseSignal(const char* text)
+{
+    const char* name = strncmp(text, "SIG", 3) == 0 ? text + 3 : text;
+    const char* abbrev;
+    char* end;
+    int signo = strtol(text, &end, 10);
+
+    if(end != text && *end == 0)
+    {
+        return signo > 0 && signo < NSIG ? signo : -1;
+    }
+
+    for(signo = 1; signo < NSIG; signo++)
+    {
+        abbrev = sigabbrev_np(signo);
+        if(abbrev != NULL && strcmp(abbrev, name) == 0)
+        {
+            return signo;
+        }
+    }
+
+    return -1;
+}
+
+/*
+*   Swap two entries of the deadline heap.
+*/
+void swapDeadlines(struct deadlineHeap* heap, int i, int j)
+{
+    struct deadline temp = heap->entries[i];
+
+    heap->entries[i] = heap->entries[j];
+    heap->entries[j] = temp;
+}
+
+/*
+*   Move entry i of the heap up or down to its place by time.
+*/
+void siftDeadline(struct deadlineHeap* heap, int i)
+{
+    int child;
+
+    while(i > 0 && heap->entries[i].when < heap->entries[(i - 1) / 2].when)
+    {
+        swapDeadlines(heap, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+
+    while((child = 2 * i + 1) < heap->numEntries)
+    {
+        if(child + 1 < heap->numEntries &&
+            heap->entries[child + 1].when < heap->entries[child].when)
+        {
+            child++;
+        }
+        if(heap->entries[i].when <= heap->entries[child].when)
+        {
+            break;
+        }
+        swapDeadlines(heap, i, child);
+        i = child;
+    }
+}
+
+/*
+*   Arm the timer for the first deadline, or disarm it if there is
+*   none. The timer is created on first use.
+*/
+void armDeadlineTimer(struct shellContext* shell)
+{
+    struct itimerspec when = {0};
+    struct deadlineHeap* heap = &shell->deadlines;
+
+    if(shell->timerFD == -1)
+    {
+        if(heap->numEntries == 0)
+        {
+            return;
+        }
+        shell->timerFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if(shell->timerFD == -1)
+        {
+            perror("timerfd_create() failed");
+            fflush(stderr);
+            return;
+        }
+    }
+
+    // A zero time disarms the timer
+    if(heap->numEntries > 0 && heap->entries[0].when != NO_DEADLINE)
+    {
+        when.it_value.tv_sec = heap->entries[0].when / 1000000000LL;
+        when.it_value.tv_nsec = heap->entries[0].when % 1000000000LL;
+    }
+    timerfd_settime(shell->timerFD, TFD_TIMER_ABSTIME, &when, NULL);
+}
+
+/*
+*   Add a deadline for child pid, timeout nanoseconds from now. signo
+*   is sent then, and SIGKILL grace nanoseconds later if grace is not
+*   zero.
+*/
+void addDeadline(struct shellContext* shell, pid_t pid, long long timeout, int signo, long long grace)
+{
+    struct deadlineHeap* heap = &shell->deadlines;
+    struct deadline* entry;
+
+    if(heap->numEntries == heap->capacity)
+    {
+        heap->capacity = heap->capacity ? heap->capacity * 2 : 8;
+        heap->entries = realloc(heap->entries, heap->capacity * sizeof(struct deadline));
+    }
+
+    entry = &heap->entries[heap->numEntries++];
+    entry->when = monotonicNs() + timeout;
+    entry->pid = pid;
+    entry->signal = signo;
+    entry->grace = grace;
+    entry->fired = false;
+
+    siftDeadline(heap, heap->numEntries - 1);
+    armDeadlineTimer(shell);
+}
+
+/*
+*   Remove the deadline of child pid once it has been waited for.
+*   Returns true if the timeout fired, so the child was signalled.
+*/
+bool removeDeadline(struct shellContext* shell, pid_t pid)
+{
+    struct deadlineHeap* heap = &shell->deadlines;
+    bool fired;
+    int i;
+
+    for(i = 0; i < heap->numEntries; i++)
+    {
+        if(heap->entries[i].pid == pid)
+        {
+            fired = heap->entries[i].fired;
+            heap->entries[i] = heap->entries[--heap->numEntries];
+            if(i < heap->numEntries)
+            {
+                siftDeadline(heap, i);
+            }
+            armDeadlineTimer(shell);
+            return fired;
+        }
+    }
+
+    return false;
+}
+
+/*
+*   Signal the children whose deadlines have passed. A child sent its
+*   first signal gets a new deadline for SIGKILL after its grace time.
+*/
+void fireDeadlines(struct shellContext* shell)
+{
+    struct deadlineHeap* heap = &shell->deadlines;
+    struct deadline* entry;
+    unsigned long long expirations;
+    long long now = monotonicNs();
+
+    // Clear the timer, it is armed again below
+    read(shell->timerFD, &expirations, sizeof(expirations));
+
+    while(heap->numEntries > 0 && heap->entries[0].when <= now)
+    {
+        entry = &heap->entries[0];
+        kill(entry->pid, entry->signal);
+        entry->fired = true;
+        if(entry->signal != SIGKILL && entry->grace > 0)
+        {
+            entry->signal = SIGKILL;
+            entry->when = now + entry->grace;
+        }
+        else
+        {
+            entry->when = NO_DEADLINE;
+        }
+        siftDeadline(heap, 0);
+    }
+
+    armDeadlineTimer(shell);
+}
@@ -0,0 +1,223 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "board.h"
+
+/*
+*   Reader for the status board of smallsh, the file a shell started
+*   with SMALLSH_BOARD keeps, see lib/board.h. Prints the shell, its
+*   foreground job and its background jobs for each board. A
+*   directory stands for the boards smallsh.PID in it. Reading a board
+*   is a copy of its memory, the shell is never waited for.
+*
+*   Usage: smallsh-board BOARD ...
+*   Exits with 1 if a board could not be read.
+*/
+
+/*
+*   Copy the board mapped at shared to board under its seqlock,
+*   copying again while an update is in progress.
+*/
+void readBoard(const struct statusBoard* shared, struct statusBoard* board)
+{
+    uint64_t before;
+    uint64_t after;
+    int tries = 0;
+
+    while(true)
+    {
+        before = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+        if(before % 2 == 0)
+        {
+            memcpy(board, shared, sizeof(struct statusBoard));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            after = __atomic_load_n(&shared->sequence, __ATOMIC_RELAXED);
+            if(before == after)
+            {
+                break;
+            }
+        }
+        if(++tries % 64 == 0)
+        {
+            sched_yield();
+        }
+    }
+    board->foregroundOnly = __atomic_load_n(&shared->foregroundOnly, __ATOMIC_RELAXED);
+}
+
+/*
+*   Print how long ago time in CLOCK_REALTIME ns was, or the time from
+*   it to end if end is not 0.
+*/
+void printAge(long long time, long long end)
+{
+    struct timespec now;
+
+    if(end == 0)
+    {
+        clock_gettime(CLOCK_REALTIME, &now);
+        end = now.tv_sec * 1000000000LL + now.tv_nsec;
+    }
+    printf("%8.1fs", (end - time) / 1e9);
+}
+
+/*
+*   Print job, of kind fg or bg.
+*/
+void printJob(const char* kind, const struct boardJob* job)
+{
+    char state[64];
+
+    if(job->state == BOARD_JOB_RUNNING)
+    {
+        strcpy(state, "running");
+    }
+    else if(job->waitStatus == -1)
+    {
+        strcpy(state, "done");
+    }
+    else if(WIFEXITED(job->waitStatus))
+    {
+        sprintf(state, "exit value %d", WEXITSTATUS(job->waitStatus));
+    }
+    else
+    {
+        sprintf(state, "terminated by signal %d", WTERMSIG(job->waitStatus));
+    }
+
+    printf("  %s %8d  %-26s", kind, job->pid, state);
+    printAge(job->startTime, job->state == BOARD_JOB_DONE ? job->endTime : 0);
+    printf("  %.*s\n", BOARD_ARGV_SIZE, job->argv);
+}
+
+/*
+*   Print the board in the file at path. Returns false if it is not a
+*   board that can be read.
+*/
+bool printBoard(const char* path)
+{
+    struct statusBoard board;
+    const struct statusBoard* shared;
+    struct stat info;
+    bool isAlive;
+    int fd;
+    int i;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1 || fstat(fd, &info) == -1)
+    {
+        perror(path);
+        return false;
+    }
+    if(info.st_size != sizeof(struct statusBoard))
+    {
+        fprintf(stderr, "%s: not a smallsh board\n", path);
+        close(fd);
+        return false;
+    }
+    shared = mmap(NULL, sizeof(struct statusBoard), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(shared == MAP_FAILED)
+    {
+        perror(path);
+        return false;
+    }
+    readBoard(shared, &board);
+    munmap((void*)shared, sizeof(struct statusBoard));
+
+    if(board.magic != BOARD_MAGIC || board.version != BOARD_VERSION ||
+        board.size != sizeof(struct statusBoard))
+    {
+        fprintf(stderr, "%s: not a smallsh board of version %d\n", path, BOARD_VERSION);
+        return false;
+    }
+
+    isAlive = kill(board.shellPID, 0) == 0 || errno == EPERM;
+    printf("shell %d %s, foreground-only %s\n", board.shellPID, isAlive ? "running" : "gone",
+        board.foregroundOnly ? "on" : "off");
+    if(board.foreground.state != BOARD_JOB_FREE)
+    {
+        printJob("fg", &board.foreground);
+    }
+    for(i = 0; i < board.numJobs && i < BOARD_MAX_JOBS; i++)
+    {
+        if(board.jobs[i].state != BOARD_JOB_FREE)
+        {
+            printJob("bg", &board.jobs[i]);
+        }
+    }
+
+    return true;
+}
+
+/*
+*   Print the boards smallsh.PID in the directory at path. Returns
+*   false if it could not be read.
+*/
+bool printBoardDirectory(const char* path)
+{
+    struct dirent** entries;
+    char boardPath[4096];
+    bool isRead = true;
+    int numEntries;
+    int i;
+
+    numEntries = scandir(path, &entries, NULL, alphasort);
+    if(numEntries == -1)
+    {
+        perror(path);
+        return false;
+    }
+    for(i = 0; i < numEntries; i++)
+    {
+        if(strncmp(entries[i]->d_name, "smallsh.", 8) == 0)
+        {
+            snprintf(boardPath, sizeof(boardPath), "%s/%s", path, entries[i]->d_name);
+            isRead = printBoard(boardPath) && isRead;
+        }
+        free(entries[i]);
+    }
+    free(entries);
+
+    return isRead;
+}
+
+int main(int argc, char* argv[])
+{
+    struct stat info;
+    bool isRead = true;
+    int i;
+
+    if(argc < 2)
+    {
+        fprintf(stderr, "usage: smallsh-board BOARD ...\n");
+        return 2;
+    }
+
+    for(i = 1; i < argc; i++)
+    {
+        if(stat(argv[i], &info) == 0 && S_ISDIR(info.st_mode))
+        {
+            isRead = printBoardDirectory(argv[i]) && isRead;
+        }
+        else
+        {
+            isRead = printBoard(argv[i]) && isRead;
+        }
+    }
+
+    return isRead ? 0 : 1;
+}
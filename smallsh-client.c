@@ -0,0 +1,199 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define STATUS_RECORD '\036'
+#define MAX_RECORD_LENGTH 512
+
+/*
+*   Client for smallsh --serve. Sends command lines to the server
+*   socket, from the arguments after the socket path, one line each,
+*   or from stdin. Command output is written to stdout, and the
+*   status record of each line to stderr unless -q is given.
+*
+*   Usage: smallsh-client [-q] SOCKET [COMMAND ...]
+*   Exits with the status of the last line, 128 + signal if it was
+*   terminated by a signal, or 124 if it was stopped by timeout.
+*/
+
+/*
+*   Write all len bytes of data to fd. Returns false on error.
+*/
+bool writeAll(int fd, const char* data, size_t len)
+{
+    ssize_t written;
+
+    while(len > 0)
+    {
+        written = write(fd, data, len);
+        if(written == -1)
+        {
+            return false;
+        }
+        data += written;
+        len -= written;
+    }
+    return true;
+}
+
+/*
+*   Send the command lines to the server, then shut down the writing
+*   side so the session sees end of input. Lines from stdin are sent
+*   by a process of their own so output is read while a large batch
+*   is still being sent.
+*/
+void sendLines(int server, int numCommands, char* commands[])
+{
+    char buffer[4096];
+    ssize_t numRead;
+    int i;
+
+    if(numCommands > 0)
+    {
+        for(i = 0; i < numCommands; i++)
+        {
+            if(!writeAll(server, commands[i], strlen(commands[i])) ||
+                !writeAll(server, "\n", 1))
+            {
+                break;
+            }
+        }
+    }
+    else
+    {
+        while((numRead = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0 &&
+            writeAll(server, buffer, numRead))
+        {
+        }
+    }
+
+    shutdown(server, SHUT_WR);
+}
+
+/*
+*   Returns the exit code for a status record, 0 if it has none. A
+*   line stopped by timeout gives 124, like timeout(1).
+*/
+int recordExitCode(const char* record)
+{
+    int value;
+
+    if(sscanf(record, "status=\"exit value %d\"", &value) == 1)
+    {
+        return value;
+    }
+    if(sscanf(record, "status=\"terminated by signal %d\"", &value) == 1)
+    {
+        return 128 + value;
+    }
+    if(strncmp(record, "status=\"terminated by timeout\"", 30) == 0)
+    {
+        return 124;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    struct sockaddr_un address = {0};
+    char buffer[4096];
+    char record[MAX_RECORD_LENGTH];
+    int recordLen = 0;
+    bool inRecord = false;
+    bool quiet = false;
+    int exitCode = 0;
+    int server;
+    int argi = 1;
+    ssize_t numRead;
+    ssize_t i;
+    ssize_t outStart;
+    pid_t spawnpid;
+
+    if(argi < argc && strcmp(argv[argi], "-q") == 0)
+    {
+        quiet = true;
+        argi++;
+    }
+    if(argi >= argc || strlen(argv[argi]) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "usage: smallsh-client [-q] SOCKET [COMMAND ...]\n");
+        return 2;
+    }
+
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, argv[argi]);
+    server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(server == -1 || connect(server, (struct sockaddr*)&address, sizeof(address)) == -1)
+    {
+        perror(argv[argi]);
+        return 2;
+    }
+
+    if(argc - argi > 1)
+    {
+        spawnpid = -1;
+        sendLines(server, argc - argi - 1, argv + argi + 1);
+    }
+    else
+    {
+        spawnpid = fork();
+        if(spawnpid == -1)
+        {
+            perror("fork");
+            return 2;
+        }
+        if(spawnpid == 0)
+        {
+            sendLines(server, 0, NULL);
+            _exit(EXIT_SUCCESS);
+        }
+    }
+
+    // Split output from status records as it arrives
+    while((numRead = read(server, buffer, sizeof(buffer))) > 0)
+    {
+        outStart = 0;
+        for(i = 0; i < numRead; i++)
+        {
+            if(!inRecord && buffer[i] == STATUS_RECORD)
+            {
+                writeAll(STDOUT_FILENO, buffer + outStart, i - outStart);
+                inRecord = true;
+                recordLen = 0;
+            }
+            else if(inRecord && buffer[i] == '\n')
+            {
+                record[recordLen] = 0;
+                exitCode = recordExitCode(record);
+                if(!quiet)
+                {
+                    fprintf(stderr, "%s\n", record);
+                }
+                inRecord = false;
+                outStart = i + 1;
+            }
+            else if(inRecord && recordLen < MAX_RECORD_LENGTH - 1)
+            {
+                record[recordLen++] = buffer[i];
+            }
+        }
+        if(!inRecord)
+        {
+            writeAll(STDOUT_FILENO, buffer + outStart, numRead - outStart);
+        }
+    }
+
+    close(server);
+    if(spawnpid != -1)
+    {
+        waitpid(spawnpid, NULL, 0);
+    }
+
+    return exitCode;
+}